@@ -59,7 +59,6 @@ void  PluginSynthAudioProcessorEditor::timerCallback (){
     
     //update components  based on parameter values
     updateParameters();
-    audioProcessor.updateSyntheParameters();
     
 }
 
@@ -193,44 +192,23 @@ void PluginSynthAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadca
             
             
             
-            //only update parameters if the change is significant
+            //azimuth and distance changes are smoothed by the voices, so pass every move through
             if(oMenu.get_selected_pan() == 1){
-                if(std::fabs(last_o1az - oMenu.osc1_pan.getAzimuth())  > 1){
-                    last_o1az = oMenu.osc1_pan.getAzimuth();
-                    *param->getRawParameterValue("osc1az") = oMenu.osc1_pan.getAzimuth();
-                }
-                    
-                if(std::fabs(last_o1dis - oMenu.osc1_pan.getDistance())  > 0.05){
-                    last_o1dis = oMenu.osc1_pan.getDistance();
-                    *param->getRawParameterValue("osc1distance") = oMenu.osc1_pan.getDistance();
-                }
+                *param->getRawParameterValue("osc1az") = oMenu.osc1_pan.getAzimuth();
+                *param->getRawParameterValue("osc1distance") = oMenu.osc1_pan.getDistance();
             }
             
             if(oMenu.get_selected_pan() == 2){
-                if(std::fabs(last_o2az - oMenu.osc2_pan.getAzimuth()) > 1){
-                    last_o2az = oMenu.osc2_pan.getAzimuth();
-                    *param->getRawParameterValue("osc2az") = oMenu.osc2_pan.getAzimuth();
-                }
-                
-                if(std::fabs(last_o2dis - oMenu.osc2_pan.getDistance()) > 0.05){
-                    last_o2dis = oMenu.osc2_pan.getDistance();
-                    *param->getRawParameterValue("osc2distance") = oMenu.osc2_pan.getDistance();
-                }
+                *param->getRawParameterValue("osc2az") = oMenu.osc2_pan.getAzimuth();
+                *param->getRawParameterValue("osc2distance") = oMenu.osc2_pan.getDistance();
             }
             
             if(oMenu.get_selected_pan() == 3){
-                if(std::fabs(last_o3az - oMenu.osc3_pan.getAzimuth()) > 1){
-                    last_o3az = oMenu.osc3_pan.getAzimuth();
-                    *param->getRawParameterValue("osc3az") = oMenu.osc3_pan.getAzimuth();
-                }
-                    
-                if(std::fabs(last_o3dis - oMenu.osc3_pan.getDistance())  > 0.05){
-                    last_o3dis = oMenu.osc3_pan.getDistance();
-                    *param->getRawParameterValue("osc3distance") = oMenu.osc3_pan.getDistance();
-                }
+                *param->getRawParameterValue("osc3az") = oMenu.osc3_pan.getAzimuth();
+                *param->getRawParameterValue("osc3distance") = oMenu.osc3_pan.getDistance();
             }
             
-            
+            audioProcessor.updateSyntheParameters(oscillatorGroup | gainGroup | hrirGroup);
         }
         
         if(source == &fMenu){
@@ -248,6 +226,8 @@ void PluginSynthAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadca
             *param->getRawParameterValue("filterDecay") = fMenu.filter_decay.getValue();
             *param->getRawParameterValue("filterSustain") = fMenu.filter_sustain.getValue();
             *param->getRawParameterValue("filterRelease") = fMenu.filter_release.getValue();
+            
+            audioProcessor.updateSyntheParameters(filterGroup | envelopeGroup);
         }
         
         if(source == &aMenu){
@@ -259,9 +239,8 @@ void PluginSynthAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadca
             *param->getRawParameterValue("ampSustain") = aMenu.amp_sustain.getValue();
             *param->getRawParameterValue("ampRelease") = aMenu.amp_release.getValue();
             
+            audioProcessor.updateSyntheParameters(gainGroup | envelopeGroup);
         }
-    
-    audioProcessor.updateSyntheParameters();
         
     }
 
@@ -8,6 +8,87 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "allocationGuard.h"
+
+#if SYNTH3D_CHECK_ALLOCATIONS
+#include <new>
+#include <stdlib.h>
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+//==============================================================================
+// Debug-only replacement of the global allocation operators so that any heap
+// use inside a scopedAllocationCheck (i.e. processBlock) trips an assertion.
+void* operator new (std::size_t size)
+{
+    allocationGuard::check();
+    
+    if (auto* ptr = std::malloc (size > 0 ? size : 1))
+        return ptr;
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void operator delete (void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        allocationGuard::check();
+    
+    std::free (ptr);
+}
+
+void operator delete[] (void* ptr) noexcept                  { operator delete (ptr); }
+void operator delete (void* ptr, std::size_t) noexcept       { operator delete (ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept     { operator delete (ptr); }
+
+// Over-aligned types (the alignas(32/64) lanes, queues and banks) go through
+// the std::align_val_t overloads instead, so those are guarded as well.
+void* operator new (std::size_t size, std::align_val_t alignment)
+{
+    allocationGuard::check();
+    
+    auto align = juce::jmax ((std::size_t) alignment, sizeof (void*));
+    
+   #if JUCE_WINDOWS
+    if (auto* ptr = _aligned_malloc (size > 0 ? size : 1, align))
+        return ptr;
+   #else
+    void* ptr = nullptr;
+    
+    if (posix_memalign (&ptr, align, size > 0 ? size : 1) == 0)
+        return ptr;
+   #endif
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size, std::align_val_t alignment)
+{
+    return operator new (size, alignment);
+}
+
+void operator delete (void* ptr, std::align_val_t) noexcept
+{
+    if (ptr != nullptr)
+        allocationGuard::check();
+    
+   #if JUCE_WINDOWS
+    _aligned_free (ptr);
+   #else
+    std::free (ptr);
+   #endif
+}
+
+void operator delete[] (void* ptr, std::align_val_t alignment) noexcept                  { operator delete (ptr, alignment); }
+void operator delete (void* ptr, std::size_t, std::align_val_t alignment) noexcept       { operator delete (ptr, alignment); }
+void operator delete[] (void* ptr, std::size_t, std::align_val_t alignment) noexcept     { operator delete (ptr, alignment); }
+#endif
 
 //==============================================================================
 PluginSynthAudioProcessor::PluginSynthAudioProcessor()
@@ -27,67 +108,109 @@ PluginSynthAudioProcessor::PluginSynthAudioProcessor()
     //add all parameters as available for vst
 //    addVSTParam();
     
-    //initialize synth voices and sound
-    for (auto i = 0; i < 4; ++i)
-        synth.addVoice (new synthVoice(&param));
+    //resolve every parameter once, and follow its changes even when the editor is closed
+    for (auto i = 0; i < numParameters; ++i){
+        rawParameters[(size_t) i] = param.getRawParameterValue (synthParameters[i].id);
+        jassert (rawParameters[(size_t) i] != nullptr);
+        
+        if (synthParameters[i].group == 0)
+            continue;
+        
+        watchers[(size_t) i].dirty = &dirtyGroups;
+        watchers[(size_t) i].group = synthParameters[i].group;
+        param.addParameterListener (synthParameters[i].id, &watchers[(size_t) i]);
+    }
+    
+    //preallocate the whole voice pool, polyphony decides how many of them can play
+    for (auto i = 0; i < synthEngine::maxVoices; ++i)
+        synth.addVoice (new synthVoice(&hrirSet));
+    
+    synth.setPolyphony ((int) getParameterValue (polyphonyParam));
 
     synth.addSound (new synthSound());
     
+    //the bus convolvers read the same HRIR spectra as the voices
+    for (auto& convolver : busConvolvers)
+        convolver.setResponses (&hrirSet);
     
+    //starts the render threads once parallel rendering is turned on during playback
+    startTimer (200);
 }
 
 PluginSynthAudioProcessor::~PluginSynthAudioProcessor()
 {
+    stopTimer();
+    
+    for (auto i = 0; i < numParameters; ++i)
+        param.removeParameterListener (synthParameters[i].id, &watchers[(size_t) i]);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout PluginSynthAudioProcessor::addVSTParam()
 {
     //choices to pass in when initializing variables
-    auto wavChoices = {"","Sin", "Saw", "Square", "Triangle", "Noise"};
-    auto filterChoices = {"LowPass", "HighPass", "BandPass", "BandReject"};
+    auto wavChoices = {"","Sin", "Saw", "Square", "Triangle", "Noise", "Pink Noise"};
+    auto filterChoices = {"", "LowPass", "HighPass", "BandPass", "BandReject"};
+    auto filterModelChoices = {"", "Ladder", "Biquad"};
     
     juce::AudioProcessorValueTreeState::ParameterLayout parameters;
     
-    parameters.add( std::make_unique<juce::AudioParameterChoice>("osc1wavShape", "Oscillator 1 Wav Shape", wavChoices, 1));
-    parameters.add( std::make_unique<juce::AudioParameterChoice>("osc2wavShape", "Oscillator 2 Wav Shape", wavChoices, 1));
-    parameters.add( std::make_unique<juce::AudioParameterChoice>("osc3wavShape", "Oscillator 3 Wav Shape", wavChoices, 1));
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[osc1wavShapeParam].id, "Oscillator 1 Wav Shape", wavChoices, 1));
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[osc2wavShapeParam].id, "Oscillator 2 Wav Shape", wavChoices, 1));
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[osc3wavShapeParam].id, "Oscillator 3 Wav Shape", wavChoices, 1));
+    
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc1freqOffParam].id, "Oscillator 1 Frequency Offset", juce::NormalisableRange<float> (-100.0f, 100.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc2freqOffParam].id, "Oscillator 2 Frequency Offset", juce::NormalisableRange<float> (-100.0f, 100.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc3freqOffParam].id, "Oscillator 3 Frequency Offset", juce::NormalisableRange<float> (-100.0f, 100.0f), 0));
+    
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc1gainParam].id, "Oscillator 1 Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc2gainParam].id, "Oscillator 2 Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc3gainParam].id, "Oscillator 3 Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
+    
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc1azParam].id, "Oscillator 1 Azimuth", juce::NormalisableRange<float> (0.0f, 359.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc2azParam].id, "Oscillator 2 Azimuth", juce::NormalisableRange<float> (0.0f, 359.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc3azParam].id, "Oscillator 3 Azimuth", juce::NormalisableRange<float> (0.0f, 359.0f), 0));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc1freqOff", "Oscillator 1 Frequency Offset", juce::NormalisableRange<float> (-100.0f, 100.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc2freqOff", "Oscillator 2 Frequency Offset", juce::NormalisableRange<float> (-100.0f, 100.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc3freqOff", "Oscillator 3 Frequency Offset", juce::NormalisableRange<float> (-100.0f, 100.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc1distanceParam].id, "Oscillator 1 Distance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc2distanceParam].id, "Oscillator 2 Distance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[osc3distanceParam].id, "Oscillator 3 Distance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc1gain", "Oscillator 1 Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc2gain", "Oscillator 2 Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc3gain", "Oscillator 3 Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[filter1typeParam].id, "Filter 1 Type", filterChoices, 1));
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[filter2typeParam].id, "Filter 2 Type", filterChoices, 1));
     
-    parameters.add( std::make_unique<juce::AudioParameterInt>("osc1az", "Oscillator 1 Azimuth", 0, 359, 0));
-    parameters.add( std::make_unique<juce::AudioParameterInt>("osc2az", "Oscillator 2 Azimuth", 0, 359, 0));
-    parameters.add( std::make_unique<juce::AudioParameterInt>("osc3az", "Oscillator 3 Azimuth", 0, 359, 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filter1cuttoffParam].id, "Filter 1 Cuttoff Frequency", juce::NormalisableRange<float> (20.0f, 20000.0f), 20000.0f));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filter2cuttoffParam].id, "Filter 2 Cuttoff Frequency", juce::NormalisableRange<float> (20.0f, 20000.0f), 20000.0f));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc1distance", "Oscillator 1 Distance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc2distance", "Oscillator 2 Distance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("osc3distance", "Oscillator 3 Distance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filter1resonanceParam].id, "Filter 1 Resonance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filter2resonanceParam].id, "Filter 2 Resonance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
     
-    parameters.add( std::make_unique<juce::AudioParameterChoice>("filter1type", "Filter 1 Type", filterChoices, 1));
-    parameters.add( std::make_unique<juce::AudioParameterChoice>("filter2type", "Filter 2 Type", filterChoices, 1));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filterAttackParam].id, "Filter Attack", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filterDecayParam].id, "Filter Decay", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filterSustainParam].id, "Filter Sustain", juce::NormalisableRange<float> (0.0f, 1.0f), 1));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[filterReleaseParam].id, "Filter Release", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filter1cuttoff", "Filter 1 Cuttoff Frequency", juce::NormalisableRange<float> (20.0f, 20000.0f), 20000.0f));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filter2cuttoff", "Filter 2 Cuttoff Frequency", juce::NormalisableRange<float> (20.0f, 20000.0f), 20000.0f));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[ampAttackParam].id, "Amplifier Attack", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[ampDecayParam].id, "Amplifier Decay", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[ampSustainParam].id, "Amplifier Sustain", juce::NormalisableRange<float> (0.0f, 1.0f), 1));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[ampReleaseParam].id, "Amplifier Release", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filter1resonance", "Filter 1 Resonance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filter2resonance", "Filter 2 Resonance", juce::NormalisableRange<float> (0.0f, 1.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[totalGainParam].id, "total Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filterAttack", "Filter Attack", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filterDecay", "Filter Decay", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filterSustain", "Filter Sustain", juce::NormalisableRange<float> (0.0f, 1.0f), 1));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("filterRelease", "Filter Release", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterBool>(synthParameters[binauralBusParam].id, "Shared Binaural Bus", false));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("ampAttack", "Amplifier Attack", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("ampDecay", "Amplifier Decay", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("ampSustain", "Amplifier Sustain", juce::NormalisableRange<float> (0.0f, 1.0f), 1));
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("ampRelease", "Amplifier Release", juce::NormalisableRange<float> (0.0f, 5.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterInt>(synthParameters[polyphonyParam].id, "Polyphony", 1, synthEngine::maxVoices, 16));
     
-    parameters.add( std::make_unique<juce::AudioParameterFloat>("totalGain", "total Gain", juce::NormalisableRange<float> (-100.0f, 10.0f), 0));
+    parameters.add( std::make_unique<juce::AudioParameterFloat>(synthParameters[smoothingParam].id, "Parameter Smoothing (ms)", juce::NormalisableRange<float> (0.0f, 200.0f), 20.0f));
+    
+    parameters.add( std::make_unique<juce::AudioParameterInt>(synthParameters[filterStepParam].id, "Filter Envelope Step (samples)", 1, 64, 16));
+    
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[filter1modelParam].id, "Filter 1 Model", filterModelChoices, 1));
+    parameters.add( std::make_unique<juce::AudioParameterChoice>(synthParameters[filter2modelParam].id, "Filter 2 Model", filterModelChoices, 1));
+    
+    parameters.add( std::make_unique<juce::AudioParameterBool>(synthParameters[expEnvelopesParam].id, "Exponential Envelopes", false));
+    
+    parameters.add( std::make_unique<juce::AudioParameterInt>(synthParameters[pitchBendRangeParam].id, "Pitch Bend Range (semitones)", 0, 24, 2));
+    
+    parameters.add( std::make_unique<juce::AudioParameterBool>(synthParameters[parallelVoicesParam].id, "Parallel Voice Rendering", false));
     
     return parameters;
 
@@ -162,11 +285,32 @@ void PluginSynthAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     //set synth sample rate
     synth.setCurrentPlaybackSampleRate (sampleRate);
     
-    //set sample rate and number of channels for each synthesizer voice
-    for (auto i = 0; i < 4; ++i){                // [1]
-        auto voice = (synthVoice*)synth.getVoice(i);
-        voice->prepaterToPlay(samplesPerBlock,getTotalNumOutputChannels());
+    //transform the HRIRs for this sample rate and block size before the voices use them
+    hrirSet.prepare (sampleRate, samplesPerBlock);
+    
+    //set sample rate and number of channels for every voice in the pool
+    for (auto i = 0; i < synth.getNumVoices(); ++i)
+        synth.getSynthVoice(i)->prepaterToPlay(samplesPerBlock,getTotalNumOutputChannels());
+    
+    //render threads only when parallel rendering is on, they spin a few blocks past the last one before sleeping
+    {
+        const juce::ScopedLock sl (renderPoolLock);
+        
+        synth.getRenderPool().stop();
+        synth.getRenderPool().setSpinTime (4.0 * samplesPerBlock / sampleRate);
+        prepared = true;
+        
+        startRenderPoolIfNeeded();
     }
+    
+    //shared binaural bus
+    juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) samplesPerBlock, (juce::uint32) getTotalNumOutputChannels() };
+    
+    for (auto& convolver : busConvolvers)
+        convolver.prepare (spec);
+    
+    slotBus.setSize (synthVoice::numSlots, samplesPerBlock);
+    busOutput.setSize (2, samplesPerBlock);
         
 }
 
@@ -175,6 +319,12 @@ void PluginSynthAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    
+    //no render threads while stopped
+    const juce::ScopedLock sl (renderPoolLock);
+    
+    prepared = false;
+    synth.getRenderPool().stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -206,6 +356,7 @@ bool PluginSynthAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 void PluginSynthAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    scopedAllocationCheck noAllocations;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     
@@ -219,12 +370,74 @@ void PluginSynthAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
+    //recompute only what changed since the last block, whichever thread changed it
+    auto changedGroups = dirtyGroups.exchange (0);
+    
+    if (changedGroups != 0)
+        applyParameters (readParameters(), changedGroups);
+    
+    //follow the polyphony parameter
+    auto polyphony = (int) getParameterValue (polyphonyParam);
+    
+    if (polyphony != synth.getPolyphony())
+        synth.setPolyphony (polyphony);
+    
+    //share the voices out over the render threads
+    synth.setParallelRendering (getParameterValue (parallelVoicesParam) > 0.5f);
+    
+    //switch every voice between convolving itself and feeding the shared bus
+    auto useBus = getParameterValue (binauralBusParam) > 0.5f;
+    
+    if (useBus != busRendering){
+        busRendering = useBus;
+        
+        for (auto i = 0; i < synth.getNumVoices(); ++i)
+            synth.getSynthVoice (i)->setBusRendering (busRendering);
+        
+        for (auto& convolver : busConvolvers)
+            convolver.reset();
+    }
+    
+    if (busRendering){
+        renderBinauralBus (buffer, midiMessages);
+        return;
+    }
+    
     synth.renderNextBlock (buffer, midiMessages,
                            0, buffer.getNumSamples());
     
 
 }
 
+void PluginSynthAudioProcessor::renderBinauralBus (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    auto numSamples = buffer.getNumSamples();
+    auto maxChunk = slotBus.getNumSamples();
+    
+    if (maxChunk == 0)
+        return;
+    
+    //the bus is sized for the prepared block, so anything larger is split, every chunk reading its events straight from the host's MIDI
+    for (auto chunkStart = 0; chunkStart < numSamples; chunkStart += maxChunk){
+        auto chunkLength = juce::jmin (maxChunk, numSamples - chunkStart);
+        
+        //every voice adds its dry slots into the bus
+        slotBus.clear (0, chunkLength);
+        synth.renderNextBlockToStart (slotBus, midiMessages, chunkStart, chunkLength);
+        
+        //three convolutions for the whole synth, whatever the polyphony
+        for (auto slot = 0; slot < synthVoice::numSlots; ++slot){
+            auto* left = busOutput.getWritePointer (0);
+            auto* right = buffer.getNumChannels() > 1 ? busOutput.getWritePointer (1) : nullptr;
+            
+            busConvolvers[(size_t) slot].processMono (slotBus.getReadPointer (slot), left, right, chunkLength);
+            
+            for (auto chan = juce::jmin (2, buffer.getNumChannels()); --chan >= 0;)
+                buffer.addFrom (chan, chunkStart, busOutput, chan, 0, chunkLength);
+        }
+    }
+}
+
 //==============================================================================
 bool PluginSynthAudioProcessor::hasEditor() const
 {
@@ -258,15 +471,122 @@ void PluginSynthAudioProcessor::setStateInformation (const void* data, int sizeI
             if (xmlState.get() != nullptr)
                 if (xmlState->hasTagName (param.state.getType()))
                     param.replaceState (juce::ValueTree::fromXml (*xmlState));
+    
+    //a new preset can change anything
+    updateSyntheParameters();
+}
+
+void PluginSynthAudioProcessor::updateSyntheParameters(int changedGroups)
+{
+    //the gui writes straight to the raw values, which skips the listeners, so flag what it touched
+    //the voices are never touched from here, the audio thread applies the change at its next block
+    dirtyGroups.fetch_or (changedGroups);
+}
+
+void PluginSynthAudioProcessor::setNumRenderWorkers(int numWorkers)
+{
+    //takes effect at the next prepareToPlay
+    numRenderWorkers = numWorkers;
+}
+
+void PluginSynthAudioProcessor::startRenderPoolIfNeeded()
+{
+    //a stopped pool can be started while the audio thread runs, the audio thread never waits for it
+    //once running it is only stopped or resized while the audio thread isn't (prepareToPlay, releaseResources)
+    auto& pool = synth.getRenderPool();
+    
+    if (prepared && pool.getNumWorkers() == 0 && getParameterValue (parallelVoicesParam) > 0.5f)
+        pool.start (numRenderWorkers < 0 ? getDefaultRenderWorkers() : numRenderWorkers);
 }
 
-void PluginSynthAudioProcessor::updateSyntheParameters()
+void PluginSynthAudioProcessor::timerCallback()
 {
+    //parameter listeners may be called on the audio thread, so the parameter is polled from the message thread instead
+    const juce::ScopedLock sl (renderPoolLock);
     
+    startRenderPoolIfNeeded();
+}
+
+stageClock& PluginSynthAudioProcessor::getStageClock()
+{
+    return synth.getStageClock();
+}
+
+float PluginSynthAudioProcessor::getParameterValue (int index) const noexcept
+{
+    return rawParameters[(size_t) index]->load (std::memory_order_relaxed);
+}
+
+synth_parameters PluginSynthAudioProcessor::readParameters() const
+{
+    synth_parameters p;
+    
+    p.osc1_wavShape = (int) getParameterValue (osc1wavShapeParam);
+    p.osc2_wavShape = (int) getParameterValue (osc2wavShapeParam);
+    p.osc3_wavShape = (int) getParameterValue (osc3wavShapeParam);
+    
+    p.osc1_freqOff = getParameterValue (osc1freqOffParam);
+    p.osc2_freqOff = getParameterValue (osc2freqOffParam);
+    p.osc3_freqOff = getParameterValue (osc3freqOffParam);
+    
+    p.pitch_bend_range = (int) getParameterValue (pitchBendRangeParam);
+    
+    p.osc1_gain = getParameterValue (osc1gainParam);
+    p.osc2_gain = getParameterValue (osc2gainParam);
+    p.osc3_gain = getParameterValue (osc3gainParam);
+    
+    p.osc1_az = getParameterValue (osc1azParam);
+    p.osc2_az = getParameterValue (osc2azParam);
+    p.osc3_az = getParameterValue (osc3azParam);
+    
+    p.osc1_distance = getParameterValue (osc1distanceParam);
+    p.osc2_distance = getParameterValue (osc2distanceParam);
+    p.osc3_distance = getParameterValue (osc3distanceParam);
+    
+    p.filter1_type = (int) getParameterValue (filter1typeParam);
+    p.filter2_type = (int) getParameterValue (filter2typeParam);
+    
+    p.filter1_model = (int) getParameterValue (filter1modelParam);
+    p.filter2_model = (int) getParameterValue (filter2modelParam);
+    
+    p.filter1_cuttoff = getParameterValue (filter1cuttoffParam);
+    p.filter2_cuttoff = getParameterValue (filter2cuttoffParam);
+    
+    p.filter1_resonance = getParameterValue (filter1resonanceParam);
+    p.filter2_resonance = getParameterValue (filter2resonanceParam);
+    
+    p.filter_step = (int) getParameterValue (filterStepParam);
+    
+    p.filter_attack = getParameterValue (filterAttackParam);
+    p.filter_decay = getParameterValue (filterDecayParam);
+    p.filter_sustain = getParameterValue (filterSustainParam);
+    p.filter_release = getParameterValue (filterReleaseParam);
+    
+    p.amp_attack = getParameterValue (ampAttackParam);
+    p.amp_decay = getParameterValue (ampDecayParam);
+    p.amp_sustain = getParameterValue (ampSustainParam);
+    p.amp_release = getParameterValue (ampReleaseParam);
+    
+    p.exponential_envelopes = getParameterValue (expEnvelopesParam) > 0.5f;
+    
+    p.total_gain = getParameterValue (totalGainParam);
+    
+    p.smoothing_time = getParameterValue (smoothingParam);
+    
+    return p;
+}
+
+void PluginSynthAudioProcessor::applyParameters (const synth_parameters& snapshot, int changedGroups)
+{
     //update parameters for each synthesizer voice
-    for (auto i = 0; i < 4; ++i){
-        auto voice = (synthVoice*)synth.getVoice(i);
-        voice->updateParameters();
+    for (auto i = 0; i < synth.getNumVoices(); ++i)
+        synth.getSynthVoice(i)->setParameters (snapshot, changedGroups);
+    
+    //the shared bus follows the same azimuths
+    if (changedGroups & hrirGroup){
+        busConvolvers[0].setAzimuth (snapshot.osc1_az);
+        busConvolvers[1].setAzimuth (snapshot.osc2_az);
+        busConvolvers[2].setAzimuth (snapshot.osc3_az);
     }
 }
 
@@ -15,7 +15,8 @@
 //==============================================================================
 /**
 */
-class PluginSynthAudioProcessor  : public juce::AudioProcessor
+class PluginSynthAudioProcessor  : public juce::AudioProcessor,
+                                   private juce::Timer
 {
 public:
     //==============================================================================
@@ -57,16 +58,77 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
     
     //==============================================================================
-    //Update synth paramters from gui thread
-    void updateSyntheParameters();
+    //Update synth paramters after the gui wrote to the raw values (picked up at the next block)
+    void updateSyntheParameters(int changedGroups = allGroups);
+    
+    //worker threads started for parallel voice rendering once it is turned on, -1 for the default (a quarter of the cores, at most three)
+    void setNumRenderWorkers(int numWorkers);
+    
+    //time the voices spent in each rendering stage, only counted in builds with SYNTH3D_STAGE_TIMING
+    stageClock& getStageClock();
     
     //audio value tree parameters
     juce::AudioProcessorValueTreeState param;
     
 
 private:
+    //frequency domain HRIRs shared by all voices
+    hrirSpectra hrirSet;
+    
     //synthesizer class
-    juce::Synthesiser synth;
+    synthEngine synth;
+    
+    //copy every voice parameter out of the value tree
+    synth_parameters readParameters() const;
+    
+    //audio thread: hand the values to every voice and the shared bus, recomputing only the changed groups
+    void applyParameters (const synth_parameters& snapshot, int changedGroups);
+    
+    //value of a parameter through its cached handle
+    float getParameterValue (int index) const noexcept;
+    
+    //value tree storage of every parameterIndex, looked up once so the audio thread never searches by ID
+    std::array<std::atomic<float>*, numParameters> rawParameters {};
+    
+    //groups changed since the last block, everything starts dirty
+    std::atomic<int> dirtyGroups { allGroups };
+    
+    //flags its parameter's groups on host, automation and preset changes, on whichever thread made them
+    struct parameterWatcher : public juce::AudioProcessorValueTreeState::Listener
+    {
+        void parameterChanged (const juce::String&, float) override    { dirty->fetch_or (group); }
+        
+        std::atomic<int>* dirty = nullptr;
+        int group = 0;
+    };
+    
+    std::array<parameterWatcher, numParameters> watchers;
+    
+    //render threads to start once parallel rendering is on
+    int numRenderWorkers = -1;
+    
+    //the workers spin while voices share them, so by default they take at most a quarter of the cores and never more
+    //than maxDefaultRenderWorkers, leaving the rest to the host, its gui and other plugins
+    static constexpr int maxDefaultRenderWorkers = 3;
+    
+    static int getDefaultRenderWorkers()    { return juce::jlimit (0, maxDefaultRenderWorkers, juce::SystemStats::getNumCpus() / 4); }
+    
+    //start the render threads if playback is prepared, parallel rendering is on and they aren't running, hold renderPoolLock
+    void startRenderPoolIfNeeded();
+    void timerCallback() override;
+    
+    //the message thread's starts against prepareToPlay and releaseResources, never taken on the audio thread
+    juce::CriticalSection renderPoolLock;
+    bool prepared = false;
+    
+    //render the voices into dry slot buses and convolve each slot once
+    void renderBinauralBus (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+    
+    //shared binaural bus: one dry channel per oscillator slot, one convolver per slot
+    std::array<hrirConvolver, synthVoice::numSlots> busConvolvers;
+    juce::AudioBuffer<float> slotBus;
+    juce::AudioBuffer<float> busOutput;
+    bool busRendering = false;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginSynthAudioProcessor)
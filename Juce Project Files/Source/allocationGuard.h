@@ -0,0 +1,46 @@
+//catch heap allocation on the audio thread in debug builds
+
+#pragma once
+#include <JuceHeader.h>
+
+//allocation checking is on for debug builds unless the project overrides it
+#ifndef SYNTH3D_CHECK_ALLOCATIONS
+ #define SYNTH3D_CHECK_ALLOCATIONS JUCE_DEBUG
+#endif
+
+namespace allocationGuard
+{
+    //how many no-allocation scopes the current thread is inside
+    inline int& scopeDepth()
+    {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    //called from the global allocation operators
+    inline void check()
+    {
+        auto& depth = scopeDepth();
+
+        if (depth > 0)
+        {
+            //leave the scope while asserting so the assertion's own logging can allocate
+            auto savedDepth = depth;
+            depth = 0;
+
+            //something allocated or freed memory on the audio thread
+            jassertfalse;
+
+            depth = savedDepth;
+        }
+    }
+}
+
+//mark a block of code (e.g. processBlock) as not allowed to touch the allocator
+struct scopedAllocationCheck
+{
+    scopedAllocationCheck()     { ++allocationGuard::scopeDepth(); }
+    ~scopedAllocationCheck()    { --allocationGuard::scopeDepth(); }
+
+    JUCE_DECLARE_NON_COPYABLE (scopedAllocationCheck)
+};
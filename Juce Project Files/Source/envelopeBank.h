@@ -0,0 +1,316 @@
+//ADSR envelopes for many voices rendered side by side in vector lanes
+
+#pragma once
+#include <JuceHeader.h>
+
+//one voice's filter and amplifier envelopes, driven like a pair of juce::ADSR
+//segments are linear like juce's or exponential, the voice sets them up and envelopeBank renders them alongside other voices
+class envelopeVoice
+{
+public:
+    enum envelopes{
+        filterEnvelope,
+        ampEnvelope,
+        numEnvelopes
+    };
+
+    envelopeVoice() {}
+
+    void setSampleRate(double newSampleRate){
+        jassert(newSampleRate > 0.0);
+        sampleRate = newSampleRate;
+    }
+
+    //takes effect from the next segment, except a new sustain level which a sustaining envelope moves to straight away
+    void setParameters(int env, const juce::ADSR::Parameters& newParameters){
+        auto& e = envelope[env];
+        e.parameters = newParameters;
+
+        if (e.stage == sustain)
+            startSegment(e, sustain);
+    }
+
+    //exponential segments approach their goal like an analog envelope instead of moving at a constant rate
+    void setExponential(bool shouldBeExponential){
+        exponential = shouldBeExponential;
+    }
+
+    void noteOn(){
+        for (auto& e : envelope)
+            startSegment(e, attack);
+    }
+
+    void noteOff(){
+        for (auto& e : envelope)
+            if (e.stage != idle)
+                startSegment(e, release);
+    }
+
+    void reset(){
+        for (auto& e : envelope)
+            startSegment(e, idle);
+    }
+
+    bool isActive(int env) const {
+        return envelope[env].stage != idle;
+    }
+
+    //the amplifier envelope has finished its release, nothing the voice renders can be heard any more
+    bool isFinished() const {
+        return ! isActive(ampEnvelope);
+    }
+
+    //where the next process call writes each envelope, one value per sample
+    void setOutput(int env, float* newOutput){
+        envelope[env].output = newOutput;
+    }
+
+private:
+    friend class envelopeBank;
+
+    enum stages{
+        idle,
+        attack,
+        decay,
+        sustain,
+        release
+    };
+
+    //samples a held stage waits before the bank checks on it again
+    static constexpr int holdSamples = 1 << 30;
+
+    //how far past its goal an exponential segment aims, relative to the distance it covers (smaller is more curved)
+    static constexpr float attackOvershoot = 0.3f;
+    static constexpr float decayOvershoot = 0.001f;
+
+    //every sample the level becomes level * multiplier + increment, covering linear and exponential segments alike
+    struct state
+    {
+        juce::ADSR::Parameters parameters;
+        int stage = idle;
+        float level = 0.0f;
+        float goal = 0.0f;
+        float multiplier = 1.0f;
+        float increment = 0.0f;
+        int samplesLeft = holdSamples;
+        float* output = nullptr;
+    };
+
+    //enter a stage from the current level, passing straight through the ones with no time to run
+    void startSegment(state& e, int stage){
+        for (;;){
+            e.stage = stage;
+
+            switch (stage){
+                case attack:
+                    if (e.parameters.attack > 0.0f && e.level < 1.0f){
+                        //like juce's attack the rate is fixed, so a retriggered note reaches the top sooner
+                        setRamp(e, 1.0f, e.parameters.attack * (1.0f - e.level), attackOvershoot);
+                        return;
+                    }
+
+                    e.level = 1.0f;
+                    stage = decay;
+                    break;
+
+                case decay:
+                    if (e.parameters.decay > 0.0f && e.level != e.parameters.sustain){
+                        setRamp(e, e.parameters.sustain, e.parameters.decay, decayOvershoot);
+                        return;
+                    }
+
+                    stage = sustain;
+                    break;
+
+                case sustain:
+                    hold(e, e.parameters.sustain);
+                    return;
+
+                case release:
+                    //like juce's release the time is fixed, whatever level it starts from
+                    if (e.parameters.release > 0.0f && e.level > 0.0f){
+                        setRamp(e, 0.0f, e.parameters.release, decayOvershoot);
+                        return;
+                    }
+
+                    stage = idle;
+                    break;
+
+                default:
+                    hold(e, 0.0f);
+                    return;
+            }
+        }
+    }
+
+    //called by the bank once a segment has run its samples, a held stage just holds again
+    void endSegment(state& e){
+        e.level = e.goal;
+
+        switch (e.stage){
+            case attack:    startSegment(e, decay); break;
+            case decay:     startSegment(e, sustain); break;
+            case release:   startSegment(e, idle); break;
+            default:        startSegment(e, e.stage); break;
+        }
+    }
+
+    void setRamp(state& e, float goal, float seconds, float overshoot){
+        auto numSamples = juce::jmax(1, juce::roundToInt(seconds * sampleRate));
+
+        e.goal = goal;
+        e.samplesLeft = numSamples;
+
+        if (! exponential){
+            e.multiplier = 1.0f;
+            e.increment = (goal - e.level) / (float) numSamples;
+            return;
+        }
+
+        //approach a target past the goal so the curve lands on the goal after exactly numSamples samples
+        auto target = goal + overshoot * (goal - e.level);
+        e.multiplier = (float) std::pow((double) overshoot / (1.0 + overshoot), 1.0 / numSamples);
+        e.increment = (1.0f - e.multiplier) * target;
+    }
+
+    void hold(state& e, float level){
+        e.level = e.goal = level;
+        e.multiplier = 1.0f;
+        e.increment = 0.0f;
+        e.samplesLeft = holdSamples;
+    }
+
+    state envelope[numEnvelopes];
+    double sampleRate = 44100.0;
+    bool exponential = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (envelopeVoice)
+};
+
+
+
+//renders the envelopes of many voices together, one envelope per lane
+//lanes run branch free up to the next segment end in any of them, then only the lanes whose segment ended are updated
+class envelopeBank
+{
+public:
+    //lanes per pass, one avx register or two sse ones
+    static constexpr int numLanes = 8;
+
+    //samples rendered into the lanes before they are written out to the voices' buffers
+    static constexpr int maxStep = 64;
+
+    envelopeBank() {}
+
+    //render numSamples samples of every voice's envelopes into their outputs
+    void process(envelopeVoice* const* voices, int numVoices, int numSamples) noexcept{
+
+        //envelopes are independent, so a voice may straddle two passes
+        auto numActive = 0;
+
+        for (auto v = 0; v < numVoices; ++v){
+            for (auto env = 0; env < envelopeVoice::numEnvelopes; ++env){
+                laneVoice[numActive] = voices[v];
+                laneEnvelope[numActive++] = env;
+
+                if (numActive == numLanes){
+                    processPass(numActive, numSamples);
+                    numActive = 0;
+                }
+            }
+        }
+
+        if (numActive > 0)
+            processPass(numActive, numSamples);
+    }
+
+private:
+    envelopeVoice::state& getState(int lane) noexcept{
+        return laneVoice[lane]->envelope[laneEnvelope[lane]];
+    }
+
+    void processPass(int numActive, int numSamples) noexcept{
+
+        //lane state is kept local so the compiler can see nothing else touches it
+        alignas(32) float level[numLanes] {};
+        alignas(32) float multiplier[numLanes] {};
+        alignas(32) float increment[numLanes] {};
+        int samplesLeft[numLanes];
+
+        //empty lanes hold at zero
+        std::fill(std::begin(samplesLeft), std::end(samplesLeft), envelopeVoice::holdSamples);
+
+        for (auto lane = 0; lane < numActive; ++lane)
+            load(lane, level, multiplier, increment, samplesLeft);
+
+        for (auto pos = 0; pos < numSamples; pos += maxStep){
+            auto numToProcess = juce::jmin(maxStep, numSamples - pos);
+
+            for (auto i = 0; i < numToProcess;){
+
+                //run until the first lane reaches the end of its segment
+                auto run = numToProcess - i;
+
+                for (auto lane = 0; lane < numActive; ++lane)
+                    run = std::min(run, samplesLeft[lane]);
+
+                for (auto j = i; j < i + run; ++j){
+                    alignas(32) float x[numLanes];
+
+                    for (auto lane = 0; lane < numLanes; ++lane)
+                        x[lane] = level[lane] = level[lane] * multiplier[lane] + increment[lane];
+
+                    std::copy(x, x + numLanes, io + j * numLanes);
+                }
+
+                i += run;
+
+                for (auto lane = 0; lane < numActive; ++lane){
+                    samplesLeft[lane] -= run;
+
+                    if (samplesLeft[lane] > 0)
+                        continue;
+
+                    //the sample that ended the segment reads the goal exactly, then the next stage starts from it
+                    auto& e = getState(lane);
+                    io[(i - 1) * numLanes + lane] = e.goal;
+
+                    laneVoice[lane]->endSegment(e);
+                    load(lane, level, multiplier, increment, samplesLeft);
+                }
+            }
+
+            for (auto lane = 0; lane < numActive; ++lane){
+                auto* out = getState(lane).output + pos;
+
+                for (auto i = 0; i < numToProcess; ++i)
+                    out[i] = io[i * numLanes + lane];
+            }
+        }
+
+        //hand the state back to the voices
+        for (auto lane = 0; lane < numActive; ++lane){
+            auto& e = getState(lane);
+
+            e.level = level[lane];
+            e.samplesLeft = samplesLeft[lane];
+        }
+    }
+
+    void load(int lane, float* level, float* multiplier, float* increment, int* samplesLeft) noexcept{
+        auto& e = getState(lane);
+
+        level[lane] = e.level;
+        multiplier[lane] = e.multiplier;
+        increment[lane] = e.increment;
+        samplesLeft[lane] = e.samplesLeft;
+    }
+
+    //the envelope behind each lane of the pass being rendered
+    envelopeVoice* laneVoice[numLanes] {};
+    int laneEnvelope[numLanes] {};
+
+    alignas(32) float io[maxStep * numLanes] {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (envelopeBank)
+};
@@ -315,6 +315,7 @@ public:
         osc1_wav_shape.addItem("Square",3);
         osc1_wav_shape.addItem("Triangle",4);
         osc1_wav_shape.addItem("White Noise",5);
+        osc1_wav_shape.addItem("Pink Noise",6);
         osc1_wav_shape.setSelectedId(1);
         
         osc2_wav_shape.addItem("Sine",1);
@@ -322,6 +323,7 @@ public:
         osc2_wav_shape.addItem("Square",3);
         osc2_wav_shape.addItem("Triangle",4);
         osc2_wav_shape.addItem("White Noise",5);
+        osc2_wav_shape.addItem("Pink Noise",6);
         osc2_wav_shape.setSelectedId(1);
         
         osc3_wav_shape.addItem("Sine",1);
@@ -329,6 +331,7 @@ public:
         osc3_wav_shape.addItem("Square",3);
         osc3_wav_shape.addItem("Triangle",4);
         osc3_wav_shape.addItem("White Noise",5);
+        osc3_wav_shape.addItem("Pink Noise",6);
         osc3_wav_shape.setSelectedId(1);
         
         //set freq slider settings
@@ -596,11 +599,13 @@ public:
         filter1_type.addItem("Low Pass",1);
         filter1_type.addItem("High Pass",2);
         filter1_type.addItem("Band Pass",3);
+        filter1_type.addItem("Band Reject",4);
         filter1_type.setSelectedId(1);
         
         filter2_type.addItem("Low Pass",1);
         filter2_type.addItem("High Pass",2);
         filter2_type.addItem("Band Pass",3);
+        filter2_type.addItem("Band Reject",4);
         filter2_type.setSelectedId(1);
         
         //set cuttoff freq slider settings
@@ -0,0 +1,501 @@
+//ladder and biquad filters for many voices processed side by side in vector lanes
+
+#pragma once
+#include <JuceHeader.h>
+
+//tanh for the ladders: juce's rational approximation, held to the -5 to 5 range it is valid over (the range juce's ladder table covers)
+//the clamp is written as arithmetic rather than min/max so the lane loops vectorise without fast math flags,
+//its rounding near zero is no coarser than the input quantisation of juce's own table
+inline float ladderSaturation(float x) noexcept{
+    x = 0.5f * (std::abs(x + 5.0f) - std::abs(x - 5.0f));
+    return juce::dsp::FastMathApproximations::tanh(x);
+}
+
+
+
+//one voice's two cascaded filter slots, each either a ladder (juce::dsp::LadderFilter with drive fixed at 1.2) or a biquad
+//holds models, types, targets, the coefficients last computed for them and every channel's state
+//the voice sets it up and filterBank runs it alongside other voices
+class filterVoice
+{
+public:
+    //matches the filter model choices
+    enum models{
+        ladder = 1,
+        biquad
+    };
+
+    //matches the filter type choices
+    enum types{
+        lowPass = 1,
+        highPass,
+        bandPass,
+        notch
+    };
+
+    static constexpr int numFilters = 2;
+    static constexpr int maxChannels = 3;
+    static constexpr int numStages = 5;
+
+    //a ladder uses the first two (pole and resonance), a biquad all five (b0, b1, b2, a1, a2)
+    static constexpr int numCoefficients = 5;
+
+    filterVoice(){
+        for (auto filter = 0; filter < numFilters; ++filter)
+            setFilter(filter, ladder, lowPass);
+    }
+
+    //pick the model and type of a slot, unknown values fall back to a low pass ladder
+    void setFilter(int filter, int newModel, int newType){
+        if (newModel != biquad)
+            newModel = ladder;
+
+        if (newType < lowPass || newType > notch)
+            newType = lowPass;
+
+        if (newModel == model[filter] && newType == type[filter])
+            return;
+
+        auto modelChanged = newModel != model[filter];
+
+        model[filter] = newModel;
+        type[filter] = newType;
+
+        if (newModel == ladder)
+            setLadderMix(filter);
+
+        //coefficients for the new type are worked out at the next step and ramped to
+        coefficientsValid[filter] = false;
+
+        //a new type of the same model keeps the state, so switching under a held note doesn't click, the coefficients ramp over from the old type
+        if (! modelChanged)
+            return;
+
+        //the two models keep different things in their state, so a new model starts from silence, on coefficients made for it
+        for (auto& channel : state[filter])
+            std::fill(std::begin(channel), std::end(channel), 0.0f);
+
+        jumpToTargets[filter] = true;
+    }
+
+    int getModel(int filter) const {
+        return model[filter];
+    }
+
+    int getType(int filter) const {
+        return type[filter];
+    }
+
+    //where a slot should be by the end of the step being processed, cuttoff in hz and resonance 0 to 1
+    void setTargets(int filter, float cutoffHz, float newResonance){
+        jassert(cutoffHz > 0.0f);
+        jassert(newResonance >= 0.0f && newResonance <= 1.0f);
+
+        cutoffTarget[filter] = cutoffHz;
+        resonanceTarget[filter] = newResonance;
+    }
+
+    //the channels the next process call filters in place, at most maxChannels
+    void setChannels(float* const* newChannels, int newNumChannels){
+        numChannels = juce::jlimit(0, maxChannels, newNumChannels);
+
+        for (auto chan = 0; chan < numChannels; ++chan)
+            channels[chan] = newChannels[chan];
+    }
+
+    //silence the state, the next step starts on freshly computed targets instead of ramping from the last note's
+    void reset(){
+        for (auto filter = 0; filter < numFilters; ++filter){
+            for (auto& channel : state[filter])
+                std::fill(std::begin(channel), std::end(channel), 0.0f);
+
+            coefficientsValid[filter] = false;
+            jumpToTargets[filter] = true;
+        }
+    }
+
+private:
+    friend class filterBank;
+
+    static constexpr float outputGain = 1.2f;
+
+    void setLadderMix(int filter){
+        std::array<float, numStages> newMix;
+
+        //a notch is the 12 dB low and high pass summed, which puts a pair of zeros at the cuttoff
+        switch (type[filter]){
+            case highPass:  newMix = { 1.0f, -2.0f, 1.0f, 0.0f, 0.0f }; compensation[filter] = 0.0f; break;
+            case bandPass:  newMix = { 0.0f, 0.0f, -1.0f, 1.0f, 0.0f }; compensation[filter] = 0.5f; break;
+            case notch:     newMix = { 1.0f, -2.0f, 2.0f, 0.0f, 0.0f }; compensation[filter] = 0.5f; break;
+            default:        newMix = { 0.0f, 0.0f,  1.0f, 0.0f, 0.0f }; compensation[filter] = 0.5f; break;
+        }
+
+        for (auto stage = 0; stage < numStages; ++stage)
+            mix[filter][stage] = newMix[(size_t) stage] * outputGain;
+    }
+
+    int model[numFilters] {};
+    int type[numFilters] {};
+    float mix[numFilters][numStages] {};
+    float compensation[numFilters] {};
+
+    float cutoffTarget[numFilters] { 200.0f, 200.0f };
+    float resonanceTarget[numFilters] {};
+
+    //coefficients for the targets, only recomputed once the model, type, cuttoff or resonance actually change
+    float computedCutoff[numFilters] {};
+    float computedResonance[numFilters] {};
+    bool coefficientsValid[numFilters] {};
+    float coefficientTarget[numFilters][numCoefficients] {};
+
+    //where the last step ended
+    float coefficient[numFilters][numCoefficients] {};
+    bool jumpToTargets[numFilters] { true, true };
+
+    //a biquad keeps its two delays in the first two stages
+    float state[numFilters][maxChannels][numStages] {};
+
+    float* channels[maxChannels] {};
+    int numChannels = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (filterVoice)
+};
+
+
+
+//runs the filters of many voices together, one (voice, channel) pair per lane
+//every lane steps through the same sample at once, so the per sample loops over lanes compile to sse or avx
+//instead of each voice running its own serial filter
+class filterBank
+{
+public:
+    //lanes per pass, one avx register or two sse ones
+    static constexpr int numLanes = 8;
+
+    //longest control step, the filter envelope step parameter's maximum
+    static constexpr int maxStep = 64;
+
+    static_assert(filterVoice::maxChannels <= numLanes, "a voice must fit in one pass");
+
+    //a voice whose filters the bank runs
+    struct client
+    {
+        virtual ~client() = default;
+
+        virtual filterVoice& getFilters() = 0;
+
+        //called at the start of every step to set the filters' targets for its end
+        virtual void updateFilterCuttoff(int numSamples) = 0;
+    };
+
+    filterBank() {}
+
+    void prepare(double newSampleRate){
+        sampleRate = (float) newSampleRate;
+    }
+
+    //filter numSamples samples of every client's channels in place, retargeting every step samples
+    void process(client* const* clients, int numClients, int numSamples, int step) noexcept{
+        step = juce::jlimit(1, maxStep, step);
+
+        //pack whole voices into passes, a voice never straddles two and every voice in a pass runs the same models
+        for (auto first = 0; first < numClients;){
+            auto& firstVoice = clients[first]->getFilters();
+            auto last = first;
+            auto lanesUsed = 0;
+
+            while (last < numClients){
+                auto& voice = clients[last]->getFilters();
+
+                if (lanesUsed + voice.numChannels > numLanes || ! sameModels(voice, firstVoice))
+                    break;
+
+                lanesUsed += voice.numChannels;
+                ++last;
+            }
+
+            processPass(clients + first, last - first, numSamples, step);
+            first = last;
+        }
+    }
+
+private:
+    static constexpr int numFilters = filterVoice::numFilters;
+    static constexpr int numStages = filterVoice::numStages;
+    static constexpr int numCoefficients = filterVoice::numCoefficients;
+
+    static bool sameModels(const filterVoice& a, const filterVoice& b) noexcept{
+        for (auto f = 0; f < numFilters; ++f)
+            if (a.model[f] != b.model[f])
+                return false;
+
+        return true;
+    }
+
+    void processPass(client* const* clients, int numClients, int numSamples, int step) noexcept{
+
+        //lay the voices' channels out across the lanes
+        filterVoice* laneVoice[numLanes] {};
+        int laneChannel[numLanes] {};
+        auto numActive = 0;
+
+        for (auto i = 0; i < numClients; ++i){
+            auto& filters = clients[i]->getFilters();
+
+            for (auto chan = 0; chan < filters.numChannels; ++chan){
+                laneVoice[numActive] = &filters;
+                laneChannel[numActive++] = chan;
+            }
+        }
+
+        if (numActive == 0)
+            return;
+
+        //the whole pass shares its models, so only they run
+        bool ladderSlot[numFilters];
+
+        for (auto f = 0; f < numFilters; ++f)
+            ladderSlot[f] = laneVoice[0]->model[f] == filterVoice::ladder;
+
+        //empty lanes run on silence with zero coefficients and never touch a voice
+        clearLanes();
+
+        for (auto lane = 0; lane < numActive; ++lane){
+            auto& v = *laneVoice[lane];
+            auto chan = laneChannel[lane];
+
+            for (auto f = 0; f < numFilters; ++f){
+                compensation[f][lane] = v.compensation[f];
+
+                for (auto c = 0; c < numCoefficients; ++c)
+                    coefficient[f][c][lane] = v.coefficient[f][c];
+
+                for (auto k = 0; k < numStages; ++k){
+                    mix[f][k][lane] = v.mix[f][k];
+                    state[f][k][lane] = v.state[f][chan][k];
+                }
+            }
+        }
+
+        for (auto pos = 0; pos < numSamples; pos += step){
+            auto numToProcess = juce::jmin(step, numSamples - pos);
+
+            for (auto i = 0; i < numClients; ++i){
+                clients[i]->updateFilterCuttoff(numToProcess);
+                updateCoefficients(clients[i]->getFilters());
+            }
+
+            setRamps(laneVoice, numActive, numToProcess);
+
+            for (auto i = 0; i < numToProcess; ++i)
+                for (auto lane = 0; lane < numActive; ++lane)
+                    io[i * numLanes + lane] = laneVoice[lane]->channels[laneChannel[lane]][pos + i];
+
+            //the two slots in series
+            for (auto i = 0; i < numToProcess; ++i){
+                if (ladderSlot[0]) processLadder<0>(i); else processBiquad<0>(i);
+                if (ladderSlot[1]) processLadder<1>(i); else processBiquad<1>(i);
+            }
+
+            //land exactly on the targets, whatever rounding the ramp picked up
+            for (auto f = 0; f < numFilters; ++f)
+                for (auto c = 0; c < numCoefficients; ++c)
+                    std::copy(std::begin(coefficientTarget[f][c]), std::end(coefficientTarget[f][c]), std::begin(coefficient[f][c]));
+
+            for (auto i = 0; i < numToProcess; ++i)
+                for (auto lane = 0; lane < numActive; ++lane)
+                    laneVoice[lane]->channels[laneChannel[lane]][pos + i] = io[i * numLanes + lane];
+        }
+
+        //hand the state back to the voices
+        for (auto lane = 0; lane < numActive; ++lane){
+            auto& v = *laneVoice[lane];
+            auto chan = laneChannel[lane];
+
+            for (auto f = 0; f < numFilters; ++f){
+                for (auto c = 0; c < numCoefficients; ++c)
+                    v.coefficient[f][c] = coefficient[f][c][lane];
+
+                for (auto k = 0; k < numStages; ++k)
+                    v.state[f][chan][k] = state[f][k][lane];
+            }
+        }
+    }
+
+    //once per voice and step: recompute a slot's target coefficients only if what they depend on has moved
+    void updateCoefficients(filterVoice& v) noexcept{
+        for (auto f = 0; f < numFilters; ++f){
+            if (v.coefficientsValid[f] && v.computedCutoff[f] == v.cutoffTarget[f] && v.computedResonance[f] == v.resonanceTarget[f])
+                continue;
+
+            v.computedCutoff[f] = v.cutoffTarget[f];
+            v.computedResonance[f] = v.resonanceTarget[f];
+            v.coefficientsValid[f] = true;
+
+            if (v.model[f] == filterVoice::ladder)
+                setLadderCoefficients(v.coefficientTarget[f], v.cutoffTarget[f], v.resonanceTarget[f]);
+            else
+                setBiquadCoefficients(v.coefficientTarget[f], v.type[f], v.cutoffTarget[f], v.resonanceTarget[f]);
+        }
+    }
+
+    //the one pole coefficient exp(-2 pi f / fs) and the scaled resonance
+    void setLadderCoefficients(float* c, float cutoffHz, float newResonance) const noexcept{
+        c[0] = std::exp(-juce::MathConstants<float>::twoPi * cutoffHz / sampleRate);
+        c[1] = 0.1f + 0.9f * newResonance;
+        c[2] = c[3] = c[4] = 0.0f;
+    }
+
+    //RBJ cookbook biquads normalised by a0, resonance sweeps Q from butterworth to about 5, near the ladder's peak
+    void setBiquadCoefficients(float* c, int filterType, float cutoffHz, float newResonance) const noexcept{
+        auto w0 = juce::MathConstants<float>::twoPi * juce::jmin(cutoffHz, 0.45f * sampleRate) / sampleRate;
+        auto cosw = std::cos(w0);
+        auto q = juce::MathConstants<float>::sqrt2 * 0.5f * std::exp(2.0f * newResonance);
+        auto alpha = std::sin(w0) / (2.0f * q);
+
+        float b0, b1, b2;
+
+        switch (filterType){
+            case filterVoice::highPass:  b0 = 0.5f * (1.0f + cosw); b1 = -(1.0f + cosw); b2 = b0; break;
+            case filterVoice::bandPass:  b0 = alpha; b1 = 0.0f; b2 = -alpha; break;
+            case filterVoice::notch:     b0 = 1.0f; b1 = -2.0f * cosw; b2 = 1.0f; break;
+            default:                     b0 = 0.5f * (1.0f - cosw); b1 = 1.0f - cosw; b2 = b0; break;
+        }
+
+        auto a0 = 1.0f / (1.0f + alpha);
+
+        c[0] = b0 * a0;
+        c[1] = b1 * a0;
+        c[2] = b2 * a0;
+        c[3] = -2.0f * cosw * a0;
+        c[4] = (1.0f - alpha) * a0;
+    }
+
+    //per sample increments that reach every lane's targets by the end of the step
+    //stable biquads form a convex set of (a1, a2), so ramping between two of them stays stable
+    void setRamps(filterVoice* const* laneVoice, int numActive, int numSamples) noexcept{
+        for (auto lane = 0; lane < numActive; ++lane){
+            auto& v = *laneVoice[lane];
+
+            for (auto f = 0; f < numFilters; ++f){
+                for (auto c = 0; c < numCoefficients; ++c){
+                    coefficientTarget[f][c][lane] = v.coefficientTarget[f][c];
+
+                    //a slot that has just been reset or switched starts on its targets
+                    if (v.jumpToTargets[f])
+                        coefficient[f][c][lane] = v.coefficientTarget[f][c];
+                }
+            }
+        }
+
+        for (auto lane = 0; lane < numActive; ++lane)
+            for (auto f = 0; f < numFilters; ++f)
+                laneVoice[lane]->jumpToTargets[f] = false;
+
+        auto scale = 1.0f / (float) numSamples;
+
+        for (auto f = 0; f < numFilters; ++f)
+            for (auto c = 0; c < numCoefficients; ++c)
+                for (auto lane = 0; lane < numLanes; ++lane)
+                    coefficientStep[f][c][lane] = (coefficientTarget[f][c][lane] - coefficient[f][c][lane]) * scale;
+    }
+
+    //one sample of ladder f in every lane, filtering row i of io in place
+    //the row is worked on in a local copy so the compiler can see nothing aliases the lane arrays and vectorises without runtime checks
+    template <int f>
+    inline void processLadder(int i) noexcept{
+        alignas(32) float x[numLanes];
+        std::copy(io + i * numLanes, io + (i + 1) * numLanes, x);
+
+        for (auto lane = 0; lane < numLanes; ++lane){
+            auto a1 = coefficient[f][0][lane] += coefficientStep[f][0][lane];
+            auto r = coefficient[f][1][lane] += coefficientStep[f][1][lane];
+
+            auto g = 1.0f - a1;
+            auto b0 = g * 0.76923076923f;
+            auto b1 = g * 0.23076923076f;
+
+            auto s0 = state[f][0][lane], s1 = state[f][1][lane], s2 = state[f][2][lane], s3 = state[f][3][lane], s4 = state[f][4][lane];
+
+            auto dx = gain * ladderSaturation(drive * x[lane]);
+            auto a = dx + r * -4.0f * (gain2 * ladderSaturation(drive2 * s4) - dx * compensation[f][lane]);
+
+            auto b = b1 * s0 + a1 * s1 + b0 * a;
+            auto c = b1 * s1 + a1 * s2 + b0 * b;
+            auto d = b1 * s2 + a1 * s3 + b0 * c;
+            auto e = b1 * s3 + a1 * s4 + b0 * d;
+
+            state[f][0][lane] = a;
+            state[f][1][lane] = b;
+            state[f][2][lane] = c;
+            state[f][3][lane] = d;
+            state[f][4][lane] = e;
+
+            x[lane] = a * mix[f][0][lane] + b * mix[f][1][lane] + c * mix[f][2][lane] + d * mix[f][3][lane] + e * mix[f][4][lane];
+        }
+
+        std::copy(x, x + numLanes, io + i * numLanes);
+    }
+
+    //one sample of biquad f in every lane (transposed direct form II), filtering row i of io in place
+    template <int f>
+    inline void processBiquad(int i) noexcept{
+        alignas(32) float x[numLanes];
+        std::copy(io + i * numLanes, io + (i + 1) * numLanes, x);
+
+        for (auto lane = 0; lane < numLanes; ++lane){
+            auto b0 = coefficient[f][0][lane] += coefficientStep[f][0][lane];
+            auto b1 = coefficient[f][1][lane] += coefficientStep[f][1][lane];
+            auto b2 = coefficient[f][2][lane] += coefficientStep[f][2][lane];
+            auto a1 = coefficient[f][3][lane] += coefficientStep[f][3][lane];
+            auto a2 = coefficient[f][4][lane] += coefficientStep[f][4][lane];
+
+            auto in = x[lane];
+            auto out = b0 * in + state[f][0][lane];
+
+            state[f][0][lane] = b1 * in - a1 * out + state[f][1][lane];
+            state[f][1][lane] = b2 * in - a2 * out;
+
+            x[lane] = out;
+        }
+
+        std::copy(x, x + numLanes, io + i * numLanes);
+    }
+
+    void clearLanes() noexcept{
+        std::fill(std::begin(io), std::end(io), 0.0f);
+
+        for (auto f = 0; f < numFilters; ++f){
+            std::fill(std::begin(compensation[f]), std::end(compensation[f]), 0.0f);
+
+            for (auto c = 0; c < numCoefficients; ++c){
+                std::fill(std::begin(coefficient[f][c]), std::end(coefficient[f][c]), 0.0f);
+                std::fill(std::begin(coefficientTarget[f][c]), std::end(coefficientTarget[f][c]), 0.0f);
+            }
+
+            for (auto k = 0; k < numStages; ++k){
+                std::fill(std::begin(mix[f][k]), std::end(mix[f][k]), 0.0f);
+                std::fill(std::begin(state[f][k]), std::end(state[f][k]), 0.0f);
+            }
+        }
+    }
+
+    //input and feedback saturation, as juce::dsp::LadderFilter sets them up for the default drive
+    static constexpr float drive = 1.2f;
+    const float gain = std::pow(drive, -2.642f) * 0.6103f + 0.3903f;
+    const float drive2 = drive * 0.04f + 0.96f;
+    const float gain2 = std::pow(drive2, -2.642f) * 0.6103f + 0.3903f;
+
+    float sampleRate = 44100.0f;
+
+    //lane data, each array holds one value per lane
+    alignas(32) float io[maxStep * numLanes] {};
+    alignas(32) float coefficient[numFilters][numCoefficients][numLanes] {};
+    alignas(32) float coefficientTarget[numFilters][numCoefficients][numLanes] {};
+    alignas(32) float coefficientStep[numFilters][numCoefficients][numLanes] {};
+    alignas(32) float compensation[numFilters][numLanes] {};
+    alignas(32) float mix[numFilters][numStages][numLanes] {};
+    alignas(32) float state[numFilters][numStages][numLanes] {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (filterBank)
+};
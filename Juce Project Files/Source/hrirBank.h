@@ -0,0 +1,274 @@
+//decode the HRIR set once and keep it ready for convolution
+
+#pragma once
+#include <JuceHeader.h>
+
+//all 360 azimuth responses decoded from BinaryData, shared through juce::SharedResourcePointer
+class hrirBank
+{
+public:
+    //one response per degree of azimuth at 0 elevation
+    static constexpr int numAzimuths = 360;
+
+    hrirBank(){
+
+        juce::WavAudioFormat wavFormat;
+
+        for (auto azi = 0; azi < numAzimuths; ++azi){
+
+            //BinaryData lists the HRIRs first, in azimuth order
+            int dataSize = 0;
+            auto* data = BinaryData::getNamedResource(BinaryData::namedResourceList[azi], dataSize);
+
+            auto& response = responses[(size_t) azi];
+
+            if (data == nullptr)
+                continue;
+
+            std::unique_ptr<juce::AudioFormatReader> reader (wavFormat.createReaderFor(new juce::MemoryInputStream(data, (size_t) dataSize, false), true));
+
+            if (reader == nullptr)
+                continue;
+
+            //decode the whole file into memory
+            response.setSize(2, (int) reader->lengthInSamples);
+            reader->read(&response, 0, (int) reader->lengthInSamples, 0, true, true);
+
+            irSampleRate = reader->sampleRate;
+        }
+    }
+
+    //wrap any azimuth into 0-359
+    static int wrapAzimuth(int azimuth){
+        return ((azimuth % numAzimuths) + numAzimuths) % numAzimuths;
+    }
+
+    //wrap a fractional azimuth into 0-360
+    static float wrapAzimuth(float azimuth){
+        auto wrapped = std::fmod(azimuth, (float) numAzimuths);
+        return wrapped < 0 ? wrapped + (float) numAzimuths : wrapped;
+    }
+
+    //decoded stereo response for an azimuth
+    const juce::AudioBuffer<float>& getResponse(int azimuth) const {
+        return responses[(size_t) wrapAzimuth(azimuth)];
+    }
+
+    //sample rate the HRIRs were recorded at
+    double getSampleRate() const {
+        return irSampleRate;
+    }
+
+private:
+    std::array<juce::AudioBuffer<float>, numAzimuths> responses;
+    double irSampleRate = 44100.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (hrirBank)
+};
+
+
+
+//frequency domain copy of every HRIR, partitioned for hrirConvolver, plus the time domain taps for its direct form
+//everything is kept in one aligned arena
+class hrirSpectra
+{
+public:
+    hrirSpectra() {}
+
+    //resample, trim, normalise and transform every azimuth for this sample rate and block size
+    void prepare(double sampleRate, int maxBlockSize){
+
+        //nothing to do if the arena already matches
+        if (sampleRate == preparedRate && maxBlockSize == preparedBlockSize)
+            return;
+
+        //get time domain responses at the processing sample rate
+        std::vector<juce::AudioBuffer<float>> processed((size_t) hrirBank::numAzimuths);
+        auto maxLength = 1;
+
+        for (auto azi = 0; azi < hrirBank::numAzimuths; ++azi){
+            processed[(size_t) azi] = makeResponse(responses->getResponse(azi), responses->getSampleRate(), sampleRate);
+            maxLength = juce::jmax(maxLength, processed[(size_t) azi].getNumSamples());
+        }
+
+        //uniform partitions sized from the host block, never longer than the response needs
+        auto longestPartition = juce::jmax(minPartitionSize, juce::nextPowerOfTwo(maxLength));
+        partitionSize = juce::jlimit(minPartitionSize, longestPartition, juce::nextPowerOfTwo(maxBlockSize));
+        numPartitions = (maxLength + partitionSize - 1) / partitionSize;
+        numBins = partitionSize + 1;
+
+        //pad every spectrum so each one starts on a 64 byte boundary
+        binStride = (numBins + 15) & ~15;
+
+        //taps padded the same way, after all the spectra
+        numTaps = maxLength;
+        tapStride = (numTaps + 15) & ~15;
+
+        auto partitionFloats = (size_t) binStride * 2;
+        spectraFloats = partitionFloats * (size_t) (hrirBank::numAzimuths * numChannels * numPartitions);
+        auto totalFloats = spectraFloats + (size_t) tapStride * (size_t) (hrirBank::numAzimuths * numChannels);
+
+        arenaStorage.calloc(totalFloats * sizeof(float) + arenaAlignment);
+        arena = reinterpret_cast<float*> ((reinterpret_cast<std::uintptr_t> (arenaStorage.get()) + arenaAlignment - 1) & ~(std::uintptr_t) (arenaAlignment - 1));
+
+        //transform each partition of each ear
+        auto fftSize = partitionSize * 2;
+        juce::dsp::FFT fft(juce::roundToInt(std::log2((double) fftSize)));
+        std::vector<float> fftBuffer((size_t) fftSize * 2);
+
+        for (auto azi = 0; azi < hrirBank::numAzimuths; ++azi){
+            auto& response = processed[(size_t) azi];
+
+            for (auto ear = 0; ear < numChannels; ++ear){
+                auto channel = juce::jmin(ear, response.getNumChannels() - 1);
+
+                if (channel >= 0)
+                    std::copy(response.getReadPointer(channel), response.getReadPointer(channel) + response.getNumSamples(), getTapsForWriting(azi, ear));
+
+                for (auto part = 0; part < numPartitions; ++part){
+                    std::fill(fftBuffer.begin(), fftBuffer.end(), 0.0f);
+
+                    auto start = part * partitionSize;
+                    auto length = juce::jmin(partitionSize, response.getNumSamples() - start);
+
+                    if (channel >= 0 && length > 0)
+                        std::copy(response.getReadPointer(channel, start), response.getReadPointer(channel, start) + length, fftBuffer.begin());
+
+                    fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+
+                    //store as split real and imaginary parts
+                    auto* dest = getPartitionForWriting(azi, ear, part);
+
+                    for (auto bin = 0; bin < numBins; ++bin){
+                        dest[bin] = fftBuffer[(size_t) bin * 2];
+                        dest[bin + binStride] = fftBuffer[(size_t) bin * 2 + 1];
+                    }
+                }
+            }
+        }
+
+        preparedRate = sampleRate;
+        preparedBlockSize = maxBlockSize;
+    }
+
+    //real parts of one partition's spectrum, the imaginary parts follow getBinStride() floats later
+    const float* getPartition(int azimuth, int ear, int partition) const noexcept {
+        return arena + partitionOffset(hrirBank::wrapAzimuth(azimuth), ear, partition);
+    }
+
+    //time domain response of one ear, getNumTaps() long and zero padded to getTapStride()
+    const float* getTaps(int azimuth, int ear) const noexcept {
+        return arena + tapsOffset(hrirBank::wrapAzimuth(azimuth), ear);
+    }
+
+    int getPartitionSize() const noexcept   { return partitionSize; }
+    int getNumPartitions() const noexcept   { return numPartitions; }
+    int getNumBins() const noexcept         { return numBins; }
+    int getBinStride() const noexcept       { return binStride; }
+    int getNumTaps() const noexcept         { return numTaps; }
+    int getTapStride() const noexcept       { return tapStride; }
+    bool isPrepared() const noexcept        { return arena != nullptr; }
+
+    //left and right ear
+    static constexpr int numChannels = 2;
+
+private:
+    static constexpr int minPartitionSize = 64;
+    static constexpr size_t arenaAlignment = 64;
+
+    //match what juce::dsp::Convolution did with Trim::yes and Normalise::yes
+    static juce::AudioBuffer<float> makeResponse(const juce::AudioBuffer<float>& source, double sourceRate, double targetRate){
+
+        juce::AudioBuffer<float> response;
+
+        if (source.getNumSamples() == 0)
+            return response;
+
+        //resample to the processing rate
+        if (sourceRate == targetRate || sourceRate <= 0){
+            response.makeCopyOf(source);
+        }
+        else{
+            auto ratio = sourceRate / targetRate;
+            auto length = (int) std::ceil(source.getNumSamples() / ratio);
+            response.setSize(source.getNumChannels(), length);
+
+            for (auto chan = 0; chan < source.getNumChannels(); ++chan){
+                juce::LagrangeInterpolator interpolator;
+                interpolator.process(ratio, source.getReadPointer(chan), response.getWritePointer(chan), length, source.getNumSamples(), 0);
+            }
+        }
+
+        //trim silence below -80 dB from both ends
+        auto threshold = juce::Decibels::decibelsToGain(-80.0f);
+        auto first = response.getNumSamples();
+        auto last = 0;
+
+        for (auto chan = 0; chan < response.getNumChannels(); ++chan){
+            auto* data = response.getReadPointer(chan);
+
+            for (auto i = 0; i < response.getNumSamples(); ++i){
+                if (std::abs(data[i]) > threshold){
+                    first = juce::jmin(first, i);
+                    last = juce::jmax(last, i + 1);
+                }
+            }
+        }
+
+        if (first >= last)
+            return {};
+
+        juce::AudioBuffer<float> trimmed(response.getNumChannels(), last - first);
+
+        for (auto chan = 0; chan < response.getNumChannels(); ++chan)
+            trimmed.copyFrom(chan, 0, response, chan, first, last - first);
+
+        //normalise by the loudest ear's energy
+        auto maxEnergy = 0.0f;
+
+        for (auto chan = 0; chan < trimmed.getNumChannels(); ++chan){
+            auto* data = trimmed.getReadPointer(chan);
+            maxEnergy = juce::jmax(maxEnergy, std::inner_product(data, data + trimmed.getNumSamples(), data, 0.0f));
+        }
+
+        if (maxEnergy > 0.0f)
+            trimmed.applyGain(0.125f / std::sqrt(maxEnergy));
+
+        return trimmed;
+    }
+
+    size_t partitionOffset(int azimuth, int ear, int partition) const noexcept {
+        return (((size_t) azimuth * numChannels + (size_t) ear) * (size_t) numPartitions + (size_t) partition) * (size_t) binStride * 2;
+    }
+
+    float* getPartitionForWriting(int azimuth, int ear, int partition) noexcept {
+        return arena + partitionOffset(azimuth, ear, partition);
+    }
+
+    size_t tapsOffset(int azimuth, int ear) const noexcept {
+        return spectraFloats + ((size_t) azimuth * numChannels + (size_t) ear) * (size_t) tapStride;
+    }
+
+    float* getTapsForWriting(int azimuth, int ear) noexcept {
+        return arena + tapsOffset(azimuth, ear);
+    }
+
+    //decoded responses shared by every plugin instance
+    juce::SharedResourcePointer<hrirBank> responses;
+
+    //one allocation holding every spectrum
+    juce::HeapBlock<char> arenaStorage;
+    float* arena = nullptr;
+
+    double preparedRate = 0;
+    int preparedBlockSize = 0;
+    int partitionSize = 0;
+    int numPartitions = 0;
+    int numBins = 0;
+    int binStride = 0;
+    int numTaps = 0;
+    int tapStride = 0;
+    size_t spectraFloats = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (hrirSpectra)
+};
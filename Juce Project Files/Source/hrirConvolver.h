@@ -0,0 +1,478 @@
+//zero latency binaural convolution against the prepared HRIR spectra
+
+#pragma once
+#include <JuceHeader.h>
+#include "hrirBank.h"
+
+//convolves a mono source with the left and right HRIR of one azimuth, with no latency
+//small host blocks run a direct form FIR over the taps, larger ones uniformly partitioned overlap-add over the spectra,
+//whichever prepare() estimates is cheaper for the block size (both read straight out of hrirSpectra)
+//fractional azimuths interpolate the neighbouring responses and every change is crossfaded
+class hrirConvolver
+{
+public:
+    hrirConvolver() {}
+
+    //set which prepared response set to read from (must outlive the convolver)
+    void setResponses(const hrirSpectra* newResponses){
+        responses = newResponses;
+    }
+
+    //safe to call from any thread, picked up at the next partition boundary
+    void setAzimuth(float newAzimuth){
+        azimuth.store(hrirBank::wrapAzimuth(newAzimuth), std::memory_order_relaxed);
+    }
+
+    float getAzimuth() const {
+        return azimuth.load(std::memory_order_relaxed);
+    }
+
+    //picks the direct or partitioned form for the host's block size
+    void prepare(const juce::dsp::ProcessSpec& spec){
+        jassert(responses != nullptr && responses->isPrepared());
+
+        partitionSize = responses->getPartitionSize();
+        numPartitions = responses->getNumPartitions();
+        numBins = responses->getNumBins();
+        binStride = responses->getBinStride();
+        tapStride = responses->getTapStride();
+        numTaps = (responses->getNumTaps() + 3) & ~3;
+
+        direct = isDirectCheaper((int) spec.maximumBlockSize);
+
+        if (direct){
+            taps.assign((size_t) (numEars * tapStride), 0.0f);
+            previousTaps.assign(taps.size(), 0.0f);
+            delayLine.assign((size_t) (numTaps - 1 + directChunk), 0.0f);
+
+            reset();
+            return;
+        }
+
+        auto fftSize = partitionSize * 2;
+        fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2((double) fftSize)));
+
+        //all working memory is allocated here, never while processing
+        inputBuffer.assign((size_t) fftSize, 0.0f);
+        fftBuffer.assign((size_t) fftSize * 2, 0.0f);
+        segments.assign((size_t) (numPartitions * binStride * 2), 0.0f);
+        spectrum.assign((size_t) binStride * 2, 0.0f);
+        response.assign((size_t) (numEars * numPartitions * binStride * 2), 0.0f);
+        previousResponse.assign(response.size(), 0.0f);
+
+        for (auto ear = 0; ear < numEars; ++ear){
+            history[ear].assign((size_t) binStride * 2, 0.0f);
+            previousHistory[ear].assign((size_t) binStride * 2, 0.0f);
+            overlap[ear].assign((size_t) partitionSize, 0.0f);
+            earOutput[ear].assign((size_t) fftSize, 0.0f);
+            previousEarOutput[ear].assign((size_t) fftSize, 0.0f);
+        }
+
+        reset();
+    }
+
+    bool isDirect() const {
+        return direct;
+    }
+
+    void reset(){
+        fading = false;
+
+        //start on the current azimuth without a crossfade
+        currentAzimuth = azimuth.load(std::memory_order_relaxed);
+
+        if (direct){
+            std::fill(delayLine.begin(), delayLine.end(), 0.0f);
+            fadePos = 0;
+            interpolateTaps(currentAzimuth, taps);
+            return;
+        }
+
+        std::fill(inputBuffer.begin(), inputBuffer.end(), 0.0f);
+        std::fill(segments.begin(), segments.end(), 0.0f);
+
+        for (auto ear = 0; ear < numEars; ++ear)
+            std::fill(overlap[ear].begin(), overlap[ear].end(), 0.0f);
+
+        inputPos = 0;
+        currentSegment = 0;
+
+        if (partitionSize > 0)
+            interpolateResponse(currentAzimuth, response);
+    }
+
+    //reads channel 0 as the source and writes the left and right ear to channels 0 and 1
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept{
+        auto&& inBlock = context.getInputBlock();
+        auto&& outBlock = context.getOutputBlock();
+
+        auto numSamples = (int) outBlock.getNumSamples();
+        auto numOutChannels = (int) outBlock.getNumChannels();
+
+        if (context.isBypassed || partitionSize == 0 || numOutChannels == 0){
+            if (context.usesSeparateInputAndOutputBlocks())
+                outBlock.copyFrom(inBlock);
+
+            return;
+        }
+
+        auto* left = outBlock.getChannelPointer(0);
+        auto* right = numOutChannels > 1 ? outBlock.getChannelPointer(1) : nullptr;
+
+        processMono(inBlock.getChannelPointer(0), left, right, numSamples);
+
+        //anything past stereo gets silence
+        for (auto chan = 2; chan < numOutChannels; ++chan)
+            outBlock.getSingleChannelBlock((size_t) chan).clear();
+    }
+
+    //input may alias left, right may be nullptr for a mono output (both ears are mixed)
+    void processMono(const float* input, float* left, float* right, int numSamples) noexcept{
+
+        if (direct){
+            processDirect(input, left, right, numSamples);
+            return;
+        }
+
+        for (auto processed = 0; processed < numSamples;){
+            auto inputWasEmpty = inputPos == 0;
+            auto numToProcess = juce::jmin(numSamples - processed, partitionSize - inputPos);
+
+            //only switch responses on a partition boundary, fading from the old one over the partition
+            if (inputWasEmpty){
+                auto target = azimuth.load(std::memory_order_relaxed);
+                fading = target != currentAzimuth;
+
+                if (fading){
+                    std::swap(response, previousResponse);
+                    interpolateResponse(target, response);
+                    currentAzimuth = target;
+                }
+            }
+
+            //append the new input to the current partition and transform it
+            std::copy(input + processed, input + processed + numToProcess, inputBuffer.begin() + inputPos);
+
+            auto* segment = getSegment(currentSegment);
+            transformInput(segment);
+
+            for (auto ear = 0; ear < numEars; ++ear){
+
+                //contributions of older partitions only change once per partition
+                if (inputWasEmpty){
+                    accumulateHistory(history[ear].data(), response, ear);
+
+                    if (fading)
+                        accumulateHistory(previousHistory[ear].data(), previousResponse, ear);
+                }
+
+                //add the current partition and go back to the time domain
+                std::copy(history[ear].begin(), history[ear].end(), spectrum.begin());
+                multiplyAccumulate(spectrum.data(), segment, getResponse(response, ear, 0));
+                inverseTransform(spectrum.data(), earOutput[ear].data());
+
+                if (fading){
+                    std::copy(previousHistory[ear].begin(), previousHistory[ear].end(), spectrum.begin());
+                    multiplyAccumulate(spectrum.data(), segment, getResponse(previousResponse, ear, 0));
+                    inverseTransform(spectrum.data(), previousEarOutput[ear].data());
+                }
+            }
+
+            //blend the old response's output into the new one across this partition
+            if (fading){
+                for (auto ear = 0; ear < numEars; ++ear){
+                    for (auto i = inputPos; i < inputPos + numToProcess; ++i){
+                        auto fadeIn = (float) (i + 1) / (float) partitionSize;
+                        earOutput[ear][(size_t) i] = previousEarOutput[ear][(size_t) i] + fadeIn * (earOutput[ear][(size_t) i] - previousEarOutput[ear][(size_t) i]);
+                    }
+                }
+            }
+
+            //write the output with the previous partition's tail
+            for (auto i = 0; i < numToProcess; ++i){
+                auto pos = (size_t) (inputPos + i);
+                auto l = earOutput[0][pos] + overlap[0][pos];
+                auto r = earOutput[1][pos] + overlap[1][pos];
+
+                if (right != nullptr){
+                    left[processed + i] = l;
+                    right[processed + i] = r;
+                }
+                else{
+                    left[processed + i] = 0.5f * (l + r);
+                }
+            }
+
+            inputPos += numToProcess;
+
+            //partition full, keep its tail (always from the new response) and move the delay line on
+            if (inputPos == partitionSize){
+                for (auto ear = 0; ear < numEars; ++ear)
+                    std::copy(earOutput[ear].begin() + partitionSize, earOutput[ear].end(), overlap[ear].begin());
+
+                std::fill(inputBuffer.begin(), inputBuffer.end(), 0.0f);
+                inputPos = 0;
+                currentSegment = currentSegment > 0 ? currentSegment - 1 : numPartitions - 1;
+            }
+
+            processed += numToProcess;
+        }
+    }
+
+private:
+    static constexpr int numEars = hrirSpectra::numChannels;
+
+    //samples the direct form takes in at once, the steps it convolves them in, and the length of its crossfades
+    static constexpr int directChunk = 64;
+    static constexpr int directStep = 16;
+    static constexpr int directFadeLength = 64;
+
+    //multiply-adds per vector instruction the direct form can count on (sse)
+    static constexpr double directVectorWidth = 4.0;
+
+    //rough operations per output sample of each form, the transforms are redone for every block however short
+    bool isDirectCheaper(int maxBlockSize) const noexcept{
+        auto blockSize = (double) juce::jlimit(1, partitionSize, maxBlockSize);
+        auto fftSize = (double) (partitionSize * 2);
+
+        auto transforms = 3.0 * 5.0 * fftSize * std::log2(fftSize) / blockSize;
+        auto spectra = numEars * numBins * 8.0 * (1.0 / blockSize + (numPartitions - 1) / (double) partitionSize);
+        auto fir = numEars * numTaps * 2.0 / directVectorWidth;
+
+        return fir <= transforms + spectra;
+    }
+
+    //the direct form works through the block in chunks, a new azimuth is only taken once the last crossfade is over
+    void processDirect(const float* input, float* left, float* right, int numSamples) noexcept{
+        alignas(32) float l[directChunk], r[directChunk];
+        alignas(32) float previousL[directChunk], previousR[directChunk];
+
+        for (auto processed = 0; processed < numSamples; processed += directChunk){
+            auto numToProcess = juce::jmin(directChunk, numSamples - processed);
+
+            if (! fading){
+                auto target = azimuth.load(std::memory_order_relaxed);
+
+                if (target != currentAzimuth){
+                    std::swap(taps, previousTaps);
+                    interpolateTaps(target, taps);
+                    currentAzimuth = target;
+                    fading = true;
+                    fadePos = 0;
+                }
+            }
+
+            //the chunk goes after the inputs the taps still reach back to, read before the output may overwrite it
+            std::copy(input + processed, input + processed + numToProcess, delayLine.begin() + numTaps - 1);
+
+            convolveDirect(taps, numToProcess, l, r);
+
+            if (fading){
+                convolveDirect(previousTaps, numToProcess, previousL, previousR);
+
+                for (auto i = 0; i < numToProcess; ++i){
+                    auto fadeIn = juce::jmin(1.0f, (float) (fadePos + i + 1) / (float) directFadeLength);
+                    l[i] = previousL[i] + fadeIn * (l[i] - previousL[i]);
+                    r[i] = previousR[i] + fadeIn * (r[i] - previousR[i]);
+                }
+
+                fadePos += numToProcess;
+                fading = fadePos < directFadeLength;
+            }
+
+            for (auto i = 0; i < numToProcess; ++i){
+                if (right != nullptr){
+                    left[processed + i] = l[i];
+                    right[processed + i] = r[i];
+                }
+                else{
+                    left[processed + i] = 0.5f * (l[i] + r[i]);
+                }
+            }
+
+            //keep the newest inputs for the next chunk
+            std::copy(delayLine.begin() + numToProcess, delayLine.begin() + numToProcess + numTaps - 1, delayLine.begin());
+        }
+    }
+
+    //out[i] is the sum of h[k] * x[i - k], the inner loop runs along the outputs so it vectorises without reordering a sum
+    //four taps are applied per pass over the outputs to cut the loads and stores of the sums
+    //the sums are local and a whole step long, a fixed count the compiler can see nothing else touches is what lets the loop vectorise
+    //so l and r are written up to the next whole step, the outputs past numSamples are thrown away
+    void convolveDirect(const std::vector<float>& source, int numSamples, float* l, float* r) const noexcept{
+        auto* hl = source.data();
+        auto* hr = source.data() + tapStride;
+
+        for (auto pos = 0; pos < numSamples; pos += directStep){
+            alignas(32) float sumL[directStep] {};
+            alignas(32) float sumR[directStep] {};
+
+            auto* x = delayLine.data() + numTaps - 1 + pos;
+
+            for (auto k = 0; k < numTaps; k += 4){
+                auto* x0 = x - k;
+                auto* x1 = x0 - 1;
+                auto* x2 = x0 - 2;
+                auto* x3 = x0 - 3;
+
+                auto l0 = hl[k], l1 = hl[k + 1], l2 = hl[k + 2], l3 = hl[k + 3];
+                auto r0 = hr[k], r1 = hr[k + 1], r2 = hr[k + 2], r3 = hr[k + 3];
+
+                for (auto i = 0; i < directStep; ++i){
+                    sumL[i] += l0 * x0[i] + l1 * x1[i] + l2 * x2[i] + l3 * x3[i];
+                    sumR[i] += r0 * x0[i] + r1 * x1[i] + r2 * x2[i] + r3 * x3[i];
+                }
+            }
+
+            std::copy(sumL, sumL + directStep, l + pos);
+            std::copy(sumR, sumR + directStep, r + pos);
+        }
+    }
+
+    //linear blend of the two neighbouring azimuths' taps
+    void interpolateTaps(float target, std::vector<float>& dest) const noexcept{
+        auto lower = (int) target;
+        auto fraction = target - (float) lower;
+
+        for (auto ear = 0; ear < numEars; ++ear){
+            auto* out = dest.data() + ear * tapStride;
+            auto* a = responses->getTaps(lower, ear);
+            auto* b = responses->getTaps(lower + 1, ear);
+
+            for (auto i = 0; i < tapStride; ++i)
+                out[i] = a[i] + fraction * (b[i] - a[i]);
+        }
+    }
+
+    float* getSegment(int index) noexcept{
+        return segments.data() + (size_t) index * (size_t) binStride * 2;
+    }
+
+    size_t responseOffset(int ear, int partition) const noexcept{
+        return ((size_t) ear * (size_t) numPartitions + (size_t) partition) * (size_t) binStride * 2;
+    }
+
+    const float* getResponse(const std::vector<float>& source, int ear, int partition) const noexcept{
+        return source.data() + responseOffset(ear, partition);
+    }
+
+    //linear blend of the two neighbouring azimuths' spectra
+    void interpolateResponse(float target, std::vector<float>& dest) const noexcept{
+        auto lower = (int) target;
+        auto fraction = target - (float) lower;
+        auto partitionFloats = binStride * 2;
+
+        for (auto ear = 0; ear < numEars; ++ear){
+            for (auto part = 0; part < numPartitions; ++part){
+                auto* out = dest.data() + responseOffset(ear, part);
+                auto* a = responses->getPartition(lower, ear, part);
+
+                if (fraction == 0.0f){
+                    std::copy(a, a + partitionFloats, out);
+                    continue;
+                }
+
+                auto* b = responses->getPartition(lower + 1, ear, part);
+
+                for (auto i = 0; i < partitionFloats; ++i)
+                    out[i] = a[i] + fraction * (b[i] - a[i]);
+            }
+        }
+    }
+
+    //sum of every older input partition times its response partition
+    void accumulateHistory(float* dest, const std::vector<float>& source, int ear) noexcept{
+        std::fill(dest, dest + binStride * 2, 0.0f);
+
+        for (auto part = 1; part < numPartitions; ++part)
+            multiplyAccumulate(dest, getSegment((currentSegment + part) % numPartitions), getResponse(source, ear, part));
+    }
+
+    //zero padded forward transform of the current input partition into split real/imaginary form
+    void transformInput(float* dest) noexcept{
+        std::copy(inputBuffer.begin(), inputBuffer.end(), fftBuffer.begin());
+        std::fill(fftBuffer.begin() + (long) inputBuffer.size(), fftBuffer.end(), 0.0f);
+
+        fft->performRealOnlyForwardTransform(fftBuffer.data(), true);
+
+        for (auto bin = 0; bin < numBins; ++bin){
+            dest[bin] = fftBuffer[(size_t) bin * 2];
+            dest[bin + binStride] = fftBuffer[(size_t) bin * 2 + 1];
+        }
+    }
+
+    //back to the time domain, the result is the first fftSize floats of dest
+    void inverseTransform(const float* source, float* dest) noexcept{
+        std::fill(fftBuffer.begin(), fftBuffer.end(), 0.0f);
+
+        for (auto bin = 0; bin < numBins; ++bin){
+            fftBuffer[(size_t) bin * 2] = source[bin];
+            fftBuffer[(size_t) bin * 2 + 1] = source[bin + binStride];
+        }
+
+        fft->performRealOnlyInverseTransform(fftBuffer.data());
+        std::copy(fftBuffer.begin(), fftBuffer.begin() + partitionSize * 2, dest);
+    }
+
+    //acc += a * b for split complex spectra
+    void multiplyAccumulate(float* acc, const float* a, const float* b) const noexcept{
+        auto* accRe = acc;
+        auto* accIm = acc + binStride;
+        auto* aRe = a;
+        auto* aIm = a + binStride;
+        auto* bRe = b;
+        auto* bIm = b + binStride;
+
+        for (auto bin = 0; bin < numBins; ++bin){
+            accRe[bin] += aRe[bin] * bRe[bin] - aIm[bin] * bIm[bin];
+            accIm[bin] += aRe[bin] * bIm[bin] + aIm[bin] * bRe[bin];
+        }
+    }
+
+    //response set and azimuth
+    const hrirSpectra* responses = nullptr;
+    std::atomic<float> azimuth { 0.0f };
+    float currentAzimuth = 0.0f;
+
+    //interpolated response in use and the one being faded out
+    std::vector<float> response;
+    std::vector<float> previousResponse;
+    bool fading = false;
+
+    //partition layout copied from the response set
+    int partitionSize = 0;
+    int numPartitions = 0;
+    int numBins = 0;
+    int binStride = 0;
+
+    //direct form: taps in use (rounded up to a multiple of four) and the one being faded out, inputs reaching back over all of them
+    bool direct = false;
+    int numTaps = 0;
+    int tapStride = 0;
+    std::vector<float> taps;
+    std::vector<float> previousTaps;
+    std::vector<float> delayLine;
+    int fadePos = 0;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+
+    //input partition being filled and its position
+    std::vector<float> inputBuffer;
+    int inputPos = 0;
+
+    //frequency domain delay line of past input partitions
+    std::vector<float> segments;
+    int currentSegment = 0;
+
+    //per ear accumulators, overlap tails and time domain output
+    std::vector<float> spectrum;
+    std::vector<float> fftBuffer;
+    std::array<std::vector<float>, numEars> history;
+    std::array<std::vector<float>, numEars> previousHistory;
+    std::array<std::vector<float>, numEars> overlap;
+    std::array<std::vector<float>, numEars> earOutput;
+    std::array<std::vector<float>, numEars> previousEarOutput;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (hrirConvolver)
+};
@@ -0,0 +1,94 @@
+//fast white and pink noise for the noise wave shapes
+
+#pragma once
+#include <JuceHeader.h>
+
+//block based noise source, one per oscillator so voices never share state
+//four interleaved xorshift streams keep the generator free of a serial dependency so it vectorises
+class noiseGenerator
+{
+public:
+    noiseGenerator(){
+        //give every generator its own streams
+        static std::atomic<juce::uint32> nextSeed { 0x9e3779b9u };
+        seed(nextSeed.fetch_add(0x6d2b79f5u));
+    }
+
+    void seed(juce::uint32 newSeed){
+        for (auto& lane : state){
+            //splitmix the seed so neighbouring seeds still give unrelated streams (and never zero)
+            newSeed += 0x9e3779b9u;
+            auto z = newSeed;
+            z = (z ^ (z >> 16)) * 0x85ebca6bu;
+            z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+            z ^= z >> 16;
+            lane = z != 0 ? z : 0x2545f491u;
+        }
+
+        reset();
+    }
+
+    //clear the pink filter, the random streams carry on
+    void reset(){
+        std::fill(pink.begin(), pink.end(), 0.0f);
+    }
+
+    //uniform white noise in -1 to 1
+    void processWhite(float* out, int numSamples) noexcept{
+        auto i = 0;
+
+        for (; i + numLanes <= numSamples; i += numLanes)
+            for (auto lane = 0; lane < numLanes; ++lane)
+                out[i + lane] = nextSample(lane);
+
+        for (auto lane = 0; i < numSamples; ++i, ++lane)
+            out[i] = nextSample(lane);
+    }
+
+    //white noise shaped to -3 dB per octave (Paul Kellet's filter), roughly the same peak level as white
+    void processPink(float* out, int numSamples) noexcept{
+        processWhite(out, numSamples);
+
+        auto b0 = pink[0], b1 = pink[1], b2 = pink[2], b3 = pink[3], b4 = pink[4], b5 = pink[5], b6 = pink[6];
+
+        for (auto i = 0; i < numSamples; ++i){
+            auto white = out[i];
+
+            b0 = 0.99886f * b0 + white * 0.0555179f;
+            b1 = 0.99332f * b1 + white * 0.0750759f;
+            b2 = 0.96900f * b2 + white * 0.1538520f;
+            b3 = 0.86650f * b3 + white * 0.3104856f;
+            b4 = 0.55000f * b4 + white * 0.5329522f;
+            b5 = -0.7616f * b5 - white * 0.0168980f;
+
+            out[i] = (b0 + b1 + b2 + b3 + b4 + b5 + b6 + white * 0.5362f) * pinkGain;
+            b6 = white * 0.115926f;
+        }
+
+        pink = { b0, b1, b2, b3, b4, b5, b6 };
+    }
+
+private:
+    static constexpr int numLanes = 4;
+    static constexpr float pinkGain = 0.11f;
+
+    //xorshift32 step, the top 23 bits become the mantissa of a float in [2, 4)
+    inline float nextSample(int lane) noexcept{
+        auto x = state[(size_t) lane];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        state[(size_t) lane] = x;
+
+        auto bits = (x >> 9) | 0x40000000u;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+
+        return value - 3.0f;
+    }
+
+    std::array<juce::uint32, numLanes> state {};
+    std::array<float, 7> pink {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (noiseGenerator)
+};
@@ -0,0 +1,317 @@
+//wavetable oscillators for many voices rendered side by side in vector lanes
+
+#pragma once
+#include <JuceHeader.h>
+#include "wavetable.h"
+#include "noiseGenerator.h"
+
+//2 to the power x for pitch modulation at audio rate, within 0.01 cents of std::exp2 over the range a pitch can reach
+//whole octaves go straight into the float's exponent and the fraction (-0.5 to 0.5) through a polynomial,
+//with no branches or library calls so the lane loops still vectorise
+inline float fastExp2(float x) noexcept{
+    x = 0.5f * (std::abs(x + 100.0f) - std::abs(x - 100.0f));
+
+    auto whole = (int) (x + 128.5f) - 128;
+    auto fraction = x - (float) whole;
+    auto power = 1.0f + fraction * (0.69314718f + fraction * (0.24022651f + fraction * (0.05550411f + fraction * (0.00961813f + fraction * 0.00133336f))));
+
+    auto bits = (whole + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+
+    return power * scale;
+}
+
+
+
+//one voice's three oscillators: shape, phase and frequency glide, and a noise source for the noise shapes
+//the voice sets it up and oscillatorBank renders it alongside other voices
+class oscillatorVoice
+{
+public:
+    static constexpr int numOscillators = 3;
+
+    oscillatorVoice() {}
+
+    //pick one of wavetableStore::shapes, used from the next block
+    void setShape(int osc, int newShape){
+        shapes[osc] = newShape;
+    }
+
+    int getShape(int osc) const {
+        return shapes[osc];
+    }
+
+    //same behaviour as juce::dsp::Oscillator::setFrequency, changes glide over 50 ms unless forced
+    void setFrequency(int osc, float newFrequency, bool force = false){
+        targetFrequency[osc] = newFrequency;
+
+        auto newIncrement = (float) (newFrequency / sampleRate);
+
+        if (force || glideLength == 0){
+            increment[osc] = target[osc] = newIncrement;
+            glideRemaining[osc] = 0;
+            return;
+        }
+
+        if (newIncrement == target[osc])
+            return;
+
+        target[osc] = newIncrement;
+        glideRemaining[osc] = glideLength;
+        incrementStep[osc] = (target[osc] - increment[osc]) / (float) glideLength;
+    }
+
+    float getFrequency(int osc) const {
+        return targetFrequency[osc];
+    }
+
+    //pitch offset of all three oscillators in octaves (pitch bend), moved to over 10 ms unless forced and applied per sample
+    void setPitch(float newPitch, bool force = false){
+        if (force || pitchRampLength == 0){
+            pitch = pitchTarget = newPitch;
+            pitchRemaining = 0;
+            return;
+        }
+
+        if (newPitch == pitchTarget)
+            return;
+
+        pitchTarget = newPitch;
+        pitchRemaining = pitchRampLength;
+        pitchStep = (pitchTarget - pitch) / (float) pitchRampLength;
+    }
+
+    float getPitch() const {
+        return pitchTarget;
+    }
+
+    void prepare(double newSampleRate){
+        sampleRate = newSampleRate;
+        glideLength = (int) std::floor(0.05 * sampleRate);
+        pitchRampLength = (int) std::floor(0.01 * sampleRate);
+
+        for (auto osc = 0; osc < numOscillators; ++osc)
+            setFrequency(osc, targetFrequency[osc], true);
+
+        setPitch(pitchTarget, true);
+
+        reset();
+    }
+
+    void reset(){
+        for (auto osc = 0; osc < numOscillators; ++osc){
+            phase[osc] = 0.0f;
+            noise[osc].reset();
+        }
+    }
+
+    //where the next process call writes each oscillator, one mono channel each
+    void setOutput(int osc, float* newOutput){
+        outputs[osc] = newOutput;
+    }
+
+private:
+    friend class oscillatorBank;
+
+    int shapes[numOscillators] { wavetableStore::sine, wavetableStore::sine, wavetableStore::sine };
+
+    //phase in cycles, the increment in cycles per sample gliding linearly to its target
+    float phase[numOscillators] {};
+    float increment[numOscillators] {};
+    float incrementStep[numOscillators] {};
+    float target[numOscillators] {};
+    int glideRemaining[numOscillators] {};
+
+    float targetFrequency[numOscillators] {};
+    double sampleRate = 44100.0;
+    int glideLength = 0;
+
+    //pitch offset in octaves ramping linearly to its target
+    float pitch = 0.0f;
+    float pitchStep = 0.0f;
+    float pitchTarget = 0.0f;
+    int pitchRemaining = 0;
+    int pitchRampLength = 0;
+
+    noiseGenerator noise[numOscillators];
+
+    float* outputs[numOscillators] {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (oscillatorVoice)
+};
+
+
+
+//renders the oscillators of many voices together, one oscillator per lane
+//phases, increments and table offsets sit in contiguous lane arrays and every lane steps through the same sample at once,
+//so phase accumulation, interpolation and the table reads (a gather from the store's single pool) vectorise across oscillators
+class oscillatorBank
+{
+public:
+    //lanes per pass, one avx register or two sse ones
+    static constexpr int numLanes = 8;
+
+    //samples rendered into the lanes before they are written out to the voices' buffers
+    static constexpr int maxStep = 64;
+
+    oscillatorBank() {}
+
+    //render numSamples samples of every voice's oscillators into their outputs
+    void process(oscillatorVoice* const* voices, int numVoices, int numSamples) noexcept{
+
+        //oscillators are independent, so a voice may straddle two passes
+        auto numActive = 0;
+
+        for (auto v = 0; v < numVoices; ++v){
+            for (auto osc = 0; osc < oscillatorVoice::numOscillators; ++osc){
+                laneVoice[numActive] = voices[v];
+                laneOscillator[numActive++] = osc;
+
+                if (numActive == numLanes){
+                    processPass(numActive, numSamples);
+                    numActive = 0;
+                }
+            }
+        }
+
+        if (numActive > 0)
+            processPass(numActive, numSamples);
+
+        for (auto v = 0; v < numVoices; ++v){
+            auto& voice = *voices[v];
+
+            //the pitch is shared by the voice's oscillators, which may have been in different passes, so it only moves on now
+            auto pitchRamp = juce::jmin(voice.pitchRemaining, numSamples);
+            voice.pitchRemaining -= pitchRamp;
+            voice.pitch = voice.pitchRemaining > 0 ? voice.pitch + voice.pitchStep * (float) pitchRamp : voice.pitchTarget;
+
+            //shapes without a table read silence in the pass and are filled with noise here
+            for (auto osc = 0; osc < oscillatorVoice::numOscillators; ++osc){
+                auto shape = voice.shapes[osc];
+
+                if (wavetableStore::hasTable(shape))
+                    continue;
+
+                if (shape == wavetableStore::pinkNoise)
+                    voice.noise[osc].processPink(voice.outputs[osc], numSamples);
+                else
+                    voice.noise[osc].processWhite(voice.outputs[osc], numSamples);
+            }
+        }
+    }
+
+private:
+    void processPass(int numActive, int numSamples) noexcept{
+
+        //lane state is kept local so the compiler can see nothing else touches it
+        alignas(32) float phase[numLanes] {};
+        alignas(32) float increment[numLanes] {};
+        alignas(32) float incrementStep[numLanes] {};
+        alignas(32) int glide[numLanes] {};
+        alignas(32) float pitch[numLanes] {};
+        alignas(32) float pitchStep[numLanes] {};
+        alignas(32) int pitchRamp[numLanes] {};
+        alignas(32) float ratio[numLanes];
+        alignas(32) int offset[numLanes] {};
+        auto pitchMoving = false;
+
+        for (auto lane = 0; lane < numActive; ++lane){
+            auto& v = *laneVoice[lane];
+            auto osc = laneOscillator[lane];
+
+            phase[lane] = v.phase[osc];
+            increment[lane] = v.increment[osc];
+            incrementStep[lane] = v.incrementStep[osc];
+            glide[lane] = juce::jmin(v.glideRemaining[osc], numSamples);
+
+            pitch[lane] = v.pitch;
+            pitchStep[lane] = v.pitchStep;
+            pitchRamp[lane] = juce::jmin(v.pitchRemaining, numSamples);
+            pitchMoving = pitchMoving || pitchRamp[lane] > 0;
+
+            //mip level for the highest frequency reached in this block
+            auto highestPitch = juce::jmax(v.pitch, v.pitch + v.pitchStep * (float) pitchRamp[lane]);
+            auto highestIncrement = juce::jmax(v.increment[osc], v.target[osc]) * std::exp2(highestPitch);
+            auto level = wavetableStore::getLevelForIncrement(highestIncrement);
+            offset[lane] = wavetableStore::getTableOffset(v.shapes[osc], level);
+        }
+
+        //a steady pitch is one ratio for the whole pass, only a moving one is worked out every sample
+        for (auto lane = 0; lane < numLanes; ++lane)
+            ratio[lane] = fastExp2(pitch[lane]);
+
+        //empty lanes read the silent table and are never written out
+        auto* pool = store->getPool();
+
+        for (auto pos = 0; pos < numSamples; pos += maxStep){
+            auto numToProcess = juce::jmin(maxStep, numSamples - pos);
+
+            for (auto i = 0; i < numToProcess; ++i){
+                alignas(32) int index[numLanes];
+                alignas(32) float fraction[numLanes], a[numLanes], b[numLanes], x[numLanes];
+
+                //samples of glide applied once this one has been read
+                auto glided = pos + i + 1;
+
+                if (pitchMoving)
+                    for (auto lane = 0; lane < numLanes; ++lane)
+                        ratio[lane] = fastExp2(pitch[lane] + pitchStep[lane] * (float) std::min(glided, pitchRamp[lane]));
+
+                for (auto lane = 0; lane < numLanes; ++lane){
+                    auto position = phase[lane] * (float) wavetableStore::tableSize;
+                    auto whole = (int) position;
+
+                    fraction[lane] = position - (float) whole;
+                    index[lane] = offset[lane] + whole;
+
+                    auto next = phase[lane] + (increment[lane] + incrementStep[lane] * (float) std::min(glided, glide[lane])) * ratio[lane];
+                    phase[lane] = next - (float) (int) next;
+                }
+
+                //the reads are kept apart from the arithmetic, without hardware gathers they would stop the loops above and below vectorising
+                for (auto lane = 0; lane < numLanes; ++lane){
+                    a[lane] = pool[index[lane]];
+                    b[lane] = pool[index[lane] + 1];
+                }
+
+                for (auto lane = 0; lane < numLanes; ++lane)
+                    x[lane] = a[lane] + fraction[lane] * (b[lane] - a[lane]);
+
+                std::copy(x, x + numLanes, io + i * numLanes);
+            }
+
+            for (auto lane = 0; lane < numActive; ++lane){
+                auto* out = laneVoice[lane]->outputs[laneOscillator[lane]] + pos;
+
+                for (auto i = 0; i < numToProcess; ++i)
+                    out[i] = io[i * numLanes + lane];
+            }
+        }
+
+        //hand the state back to the voices
+        for (auto lane = 0; lane < numActive; ++lane){
+            auto& v = *laneVoice[lane];
+            auto osc = laneOscillator[lane];
+
+            v.phase[osc] = phase[lane];
+            v.glideRemaining[osc] -= glide[lane];
+
+            //land exactly on the target once the glide is over
+            v.increment[osc] = v.glideRemaining[osc] > 0 ? increment[lane] + incrementStep[lane] * (float) glide[lane]
+                                                         : v.target[osc];
+        }
+
+    }
+
+    //shared tables
+    juce::SharedResourcePointer<wavetableStore> store;
+
+    //the oscillator behind each lane of the pass being rendered
+    oscillatorVoice* laneVoice[numLanes] {};
+    int laneOscillator[numLanes] {};
+
+    alignas(32) float io[maxStep * numLanes] {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (oscillatorBank)
+};
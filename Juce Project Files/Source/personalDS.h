@@ -10,70 +10,147 @@
   ==============================================================================
 */
 
+//plain copy of every value the voices need, the audio thread copies it out of the value tree when a parameter group is dirty and applies it at the block boundary
 struct synth_parameters {
-    juce::AudioParameterChoice* osc1_wavShape;
-    juce::AudioParameterChoice*  osc2_wavShape;
-    juce::AudioParameterChoice* osc3_wavShape;
-    juce::AudioParameterFloat* osc1_freqOff;
-    juce::AudioParameterFloat* osc2_freqOff;
-    juce::AudioParameterFloat* osc3_freqOff;
-    juce::AudioParameterFloat* osc1_gain;
-    juce::AudioParameterFloat* osc2_gain;
-    juce::AudioParameterFloat* osc3_gain;
-    juce::AudioParameterInt* osc1_az;
-    juce::AudioParameterInt* osc2_az;
-    juce::AudioParameterInt* osc3_az;
-    juce::AudioParameterFloat* osc1_distance;
-    juce::AudioParameterFloat* osc2_distance;
-    juce::AudioParameterFloat* osc3_distance;
-    juce::AudioParameterChoice* filter1_type;
-    juce::AudioParameterChoice* filter2_type;
-    juce::AudioParameterFloat* filter1_cuttoff;
-    juce::AudioParameterFloat* filter2_cuttoff;
-    juce::AudioParameterFloat* filter1_resonance;
-    juce::AudioParameterFloat* filter2_resonance;
-    juce::AudioParameterFloat* filter_attack;
-    juce::AudioParameterFloat* filter_decay;
-    juce::AudioParameterFloat* filter_sustain;
-    juce::AudioParameterFloat* filter_release;
-    juce::AudioParameterFloat* amp_attack;
-    juce::AudioParameterFloat* amp_decay;
-    juce::AudioParameterFloat* amp_sustain;
-    juce::AudioParameterFloat* amp_release;
-    juce::AudioParameterFloat* total_gain;
+    int osc1_wavShape = 1;
+    int osc2_wavShape = 1;
+    int osc3_wavShape = 1;
+    float osc1_freqOff = 0;
+    float osc2_freqOff = 0;
+    float osc3_freqOff = 0;
+    int pitch_bend_range = 2;
+    float osc1_gain = 0;
+    float osc2_gain = 0;
+    float osc3_gain = 0;
+    float osc1_az = 0;
+    float osc2_az = 0;
+    float osc3_az = 0;
+    float osc1_distance = 0;
+    float osc2_distance = 0;
+    float osc3_distance = 0;
+    int filter1_type = 1;
+    int filter2_type = 1;
+    int filter1_model = 1;
+    int filter2_model = 1;
+    float filter1_cuttoff = 20000;
+    float filter2_cuttoff = 20000;
+    float filter1_resonance = 0;
+    float filter2_resonance = 0;
+    int filter_step = 16;
+    float filter_attack = 0;
+    float filter_decay = 0;
+    float filter_sustain = 1;
+    float filter_release = 0;
+    float amp_attack = 0;
+    float amp_decay = 0;
+    float amp_sustain = 1;
+    float amp_release = 0;
+    bool exponential_envelopes = false;
+    float total_gain = 0;
+    float smoothing_time = 20;
 };
 
-//struct synth_parameters {
-//    int osc1_wavShape = 1;
-//    int osc2_wavShape = 1;
-//    int osc3_wavShape = 1;
-//    float osc1_freqOff = 0;
-//    float osc2_freqOff = 0;
-//    float osc3_freqOff = 0;
-//    float osc1_gain = 0;
-//    float osc2_gain = 0;
-//    float osc3_gain = 0;
-//    int osc1_az = 0;
-//    int osc2_az = 0;
-//    int osc3_az = 0;
-//    float osc1_distance = 0;
-//    float osc2_distance = 0;
-//    float osc3_distance = 0;
-//    int filter1_type = 1;
-//    int filter2_type = 1;
-//    float filter1_cuttoff = 20000;
-//    float filter2_cuttoff = 20000;
-//    float filter1_resonance = 0;
-//    float filter2_resonance = 0;
-//    float filter_attack = 0;
-//    float filter_decay = 0;
-//    float filter_sustain = 1;
-//    float filter_release = 0;
-//    float amp_attack = 0;
-//    float amp_decay = 0;
-//    float amp_sustain = 1;
-//    float amp_release = 0;
-//    float total_gain = 0;
-//};
+//parts of a voice that depend on each group of parameters, so a change only recomputes what it touches
+enum parameterGroups {
+    oscillatorGroup = 1 << 0,   //wave shapes, frequency offsets and pitch bend range
+    gainGroup = 1 << 1,         //oscillator, distance and total gains
+    filterGroup = 1 << 2,       //filter models, types, cuttoffs and resonances
+    envelopeGroup = 1 << 3,     //filter and amplifier ADSRs and their curve
+    hrirGroup = 1 << 4,         //azimuths
+    smoothingGroup = 1 << 5,    //ramp time of the continuous parameters
+    allGroups = (1 << 6) - 1
+};
+
+//every parameter in the value tree, in the order addVSTParam adds them
+enum parameterIndex {
+    osc1wavShapeParam,
+    osc2wavShapeParam,
+    osc3wavShapeParam,
+    osc1freqOffParam,
+    osc2freqOffParam,
+    osc3freqOffParam,
+    osc1gainParam,
+    osc2gainParam,
+    osc3gainParam,
+    osc1azParam,
+    osc2azParam,
+    osc3azParam,
+    osc1distanceParam,
+    osc2distanceParam,
+    osc3distanceParam,
+    filter1typeParam,
+    filter2typeParam,
+    filter1cuttoffParam,
+    filter2cuttoffParam,
+    filter1resonanceParam,
+    filter2resonanceParam,
+    filterAttackParam,
+    filterDecayParam,
+    filterSustainParam,
+    filterReleaseParam,
+    ampAttackParam,
+    ampDecayParam,
+    ampSustainParam,
+    ampReleaseParam,
+    totalGainParam,
+    binauralBusParam,
+    polyphonyParam,
+    smoothingParam,
+    filterStepParam,
+    filter1modelParam,
+    filter2modelParam,
+    expEnvelopesParam,
+    pitchBendRangeParam,
+    parallelVoicesParam,
+    numParameters
+};
+
+//ID and parameterGroups bits of each parameterIndex (polyphony, the bus mode and parallel rendering are checked every block instead)
+struct parameterInfo {
+    const char* id;
+    int group;
+};
+
+static constexpr parameterInfo synthParameters[numParameters] = {
+    { "osc1wavShape",        oscillatorGroup },
+    { "osc2wavShape",        oscillatorGroup },
+    { "osc3wavShape",        oscillatorGroup },
+    { "osc1freqOff",         oscillatorGroup },
+    { "osc2freqOff",         oscillatorGroup },
+    { "osc3freqOff",         oscillatorGroup },
+    { "osc1gain",            gainGroup },
+    { "osc2gain",            gainGroup },
+    { "osc3gain",            gainGroup },
+    { "osc1az",              hrirGroup },
+    { "osc2az",              hrirGroup },
+    { "osc3az",              hrirGroup },
+    { "osc1distance",        gainGroup },
+    { "osc2distance",        gainGroup },
+    { "osc3distance",        gainGroup },
+    { "filter1type",         filterGroup },
+    { "filter2type",         filterGroup },
+    { "filter1cuttoff",      filterGroup },
+    { "filter2cuttoff",      filterGroup },
+    { "filter1resonance",    filterGroup },
+    { "filter2resonance",    filterGroup },
+    { "filterAttack",        envelopeGroup },
+    { "filterDecay",         envelopeGroup },
+    { "filterSustain",       envelopeGroup },
+    { "filterRelease",       envelopeGroup },
+    { "ampAttack",           envelopeGroup },
+    { "ampDecay",            envelopeGroup },
+    { "ampSustain",          envelopeGroup },
+    { "ampRelease",          envelopeGroup },
+    { "totalGain",           gainGroup },
+    { "binauralBus",         0 },
+    { "polyphony",           0 },
+    { "smoothing",           smoothingGroup },
+    { "filterStep",          filterGroup },
+    { "filter1model",        filterGroup },
+    { "filter2model",        filterGroup },
+    { "expEnvelopes",        envelopeGroup },
+    { "pitchBendRange",      oscillatorGroup },
+    { "parallelVoices",      0 },
+};
 
 #pragma once
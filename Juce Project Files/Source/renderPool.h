@@ -0,0 +1,358 @@
+//real time worker threads that share out voice rendering with the audio thread
+
+#pragma once
+#include <JuceHeader.h>
+#include "allocationGuard.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <cerrno>
+#endif
+
+//a counting semaphore the audio thread can signal without taking a lock, unlike juce::WaitableEvent (a mutex and a condition variable)
+//posix (futex backed) and dispatch semaphores only enter the kernel when a thread is actually waiting on them
+class wakeSemaphore
+{
+public:
+    wakeSemaphore(){
+       #if JUCE_WINDOWS
+        handle = CreateSemaphoreW(nullptr, 0, 1 << 30, nullptr);
+       #elif JUCE_MAC || JUCE_IOS
+        handle = dispatch_semaphore_create(0);
+       #else
+        sem_init(&handle, 0, 0);
+       #endif
+    }
+
+    ~wakeSemaphore(){
+       #if JUCE_WINDOWS
+        CloseHandle(handle);
+       #elif JUCE_MAC || JUCE_IOS
+        dispatch_release(handle);
+       #else
+        sem_destroy(&handle);
+       #endif
+    }
+
+    void signal() noexcept{
+       #if JUCE_WINDOWS
+        ReleaseSemaphore(handle, 1, nullptr);
+       #elif JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_signal(handle);
+       #else
+        sem_post(&handle);
+       #endif
+    }
+
+    //blocks until signalled
+    void wait() noexcept{
+       #if JUCE_WINDOWS
+        WaitForSingleObject(handle, INFINITE);
+       #elif JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_wait(handle, DISPATCH_TIME_FOREVER);
+       #else
+        while (sem_wait(&handle) != 0 && errno == EINTR) {}
+       #endif
+    }
+
+private:
+   #if JUCE_WINDOWS
+    HANDLE handle;
+   #elif JUCE_MAC || JUCE_IOS
+    dispatch_semaphore_t handle;
+   #else
+    sem_t handle;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (wakeSemaphore)
+};
+
+
+
+//a fixed set of real time threads, the audio thread hands them jobs numbered 0 to n - 1
+//each participant (the audio thread is the first) gets an even share of the jobs in its own queue and steals from
+//the others once it runs dry, claiming with one compare and swap, so running jobs never locks or allocates
+//workers keep spinning for a few block periods after each run that shares jobs, so while blocks with several voices keep
+//coming they never sleep, and go to sleep on a semaphore once those stop (one voice or none, parallel rendering turned
+//off or the host not processing)
+class renderPool
+{
+public:
+    //threads besides the audio thread
+    static constexpr int maxWorkers = 15;
+
+    renderPool() {}
+
+    ~renderPool(){
+        stop();
+    }
+
+    //start numWorkers threads, off the audio thread
+    //a stopped pool may be started while the audio thread is running jobs (they just stay on the audio thread until
+    //the workers are up), but changing the number of workers or stopping must wait until it isn't (e.g. prepareToPlay)
+    void start(int numWorkers){
+        numWorkers = juce::jlimit(0, maxWorkers, numWorkers);
+
+        if (numWorkers == getNumWorkers())
+            return;
+
+        stop();
+
+        for (auto i = 0; i < numWorkers; ++i){
+            workers[(size_t) i] = std::make_unique<worker>(*this, i + 1);
+            workers[(size_t) i]->startRealtime();
+        }
+
+        //the workers are complete before a run can see them
+        activeWorkers.store(numWorkers);
+    }
+
+    void stop(){
+        activeWorkers.store(0);
+        stopping.store(true);
+
+        for (auto& w : workers)
+            if (w != nullptr)
+                w->signalThreadShouldExit();
+
+        for (auto& w : workers){
+            if (w != nullptr){
+                wakeWorker(*w);
+                w->stopThread(1000);
+                w.reset();
+            }
+        }
+
+        stopping.store(false);
+    }
+
+    int getNumWorkers() const {
+        return activeWorkers.load(std::memory_order_acquire);
+    }
+
+    //how long the workers keep spinning after a run before they sleep, at least one block period
+    //(use a few of them, hosts don't call back exactly on time), set before starting the pool or between runs
+    void setSpinTime(double seconds){
+        auto ticks = juce::Time::secondsToHighResolutionTicks(juce::jmax(seconds, minSpinSeconds));
+        spinTicks.store(ticks, std::memory_order_relaxed);
+    }
+
+    //call job(i) for every i below numJobs on the workers and the calling thread, returns once every job is done
+    //the job must not throw, and only one thread may be running jobs at a time
+    template <typename Job>
+    void run(int numJobs, Job& job) noexcept{
+        jassert(numJobs <= maxJobs);
+
+        auto numParticipants = getNumWorkers() + 1;
+
+        //nothing to share, and the workers are left to fall asleep
+        if (numJobs <= 1 || numParticipants == 1){
+            for (auto i = 0; i < numJobs; ++i)
+                job(i);
+
+            return;
+        }
+
+        auto gen = generation.load(std::memory_order_relaxed) + 1;
+
+        //even shares, stealing evens out voices that cost more than others
+        for (auto p = 0; p < numParticipants; ++p)
+            queues[(size_t) p].cursor.store(pack(gen, numJobs * p / numParticipants, numJobs * (p + 1) / numParticipants), std::memory_order_relaxed);
+
+        context.store(&job, std::memory_order_relaxed);
+        invoke.store(&invokeJob<Job>, std::memory_order_relaxed);
+        participants.store(numParticipants, std::memory_order_relaxed);
+        remaining.store(numJobs, std::memory_order_relaxed);
+
+        //publish, then wake anyone who went to sleep (both sides are sequentially consistent so a sleeper can't be missed)
+        generation.store(gen);
+
+        for (auto i = 0; i < numParticipants - 1; ++i)
+            wakeWorker(*workers[(size_t) i]);
+
+        work(0, gen);
+
+        //the last jobs may still be running on other threads
+        while (remaining.load(std::memory_order_acquire) > 0)
+            pause();
+    }
+
+private:
+    //jobs per run, a queue's positions are 16 bits
+    static constexpr int maxJobs = 1 << 15;
+
+    //shortest spin, for pools that are never told their block period
+    static constexpr double minSpinSeconds = 0.002;
+
+    //pauses between looks at the clock while spinning
+    static constexpr int pausesPerClockCheck = 64;
+
+    using jobFunction = void (*)(void*, int);
+
+    template <typename Job>
+    static void invokeJob(void* job, int index){
+        (*static_cast<Job*> (job))(index);
+    }
+
+    //generation in the top 32 bits, then the next job and the end of the queue
+    static uint64_t pack(uint32_t gen, int next, int end) noexcept{
+        return ((uint64_t) gen << 32) | ((uint64_t) next << 16) | (uint64_t) end;
+    }
+
+    //one participant's share of the current run, on its own cache line
+    struct alignas(64) queue
+    {
+        std::atomic<uint64_t> cursor { 0 };
+    };
+
+    class worker : public juce::Thread
+    {
+    public:
+        worker(renderPool& ownerPool, int participantIndex)
+            : juce::Thread("render worker " + juce::String(participantIndex)), index(participantIndex), pool(ownerPool) {}
+
+        void run() override {
+            pool.workerLoop(*this);
+        }
+
+        //juce 7.0.3 replaced the integer priorities (and realtimeAudioPriority) with real time options
+        void startRealtime(){
+           #if JUCE_MAJOR_VERSION > 7 || (JUCE_MAJOR_VERSION == 7 && (JUCE_MINOR_VERSION > 0 || JUCE_BUILDNUMBER >= 3))
+            startRealtimeThread(juce::Thread::RealtimeOptions{});
+           #else
+            startThread(juce::Thread::realtimeAudioPriority);
+           #endif
+        }
+
+        //its queue, the audio thread's is 0
+        const int index;
+
+        //set by the worker before it waits, whoever clears it owes the worker exactly one signal
+        std::atomic<bool> asleep { false };
+        wakeSemaphore wake;
+
+    private:
+        renderPool& pool;
+    };
+
+    static void pause() noexcept{
+       #if JUCE_INTEL
+        _mm_pause();
+       #endif
+    }
+
+    //signal a worker only if it is asleep, the common case (it is spinning) is one atomic exchange
+    static void wakeWorker(worker& w) noexcept{
+        if (w.asleep.exchange(false))
+            w.wake.signal();
+    }
+
+    bool shouldStop(worker& self) const {
+        return stopping.load() || self.threadShouldExit();
+    }
+
+    void workerLoop(worker& self){
+        auto seen = generation.load();
+
+        while (! shouldStop(self)){
+            auto gen = generation.load();
+
+            //spin until the next run, or until no run has come for the spin time
+            if (gen == seen){
+                auto spinEnd = juce::Time::getHighResolutionTicks() + spinTicks.load(std::memory_order_relaxed);
+
+                while (gen == seen && ! shouldStop(self)){
+                    for (auto i = 0; i < pausesPerClockCheck && gen == seen; ++i){
+                        pause();
+                        gen = generation.load();
+                    }
+
+                    if (juce::Time::getHighResolutionTicks() > spinEnd)
+                        break;
+                }
+            }
+
+            if (gen == seen){
+                //a run or stop after this store sees asleep and signals, one before it is seen below
+                self.asleep.store(true);
+
+                if (generation.load() != seen || shouldStop(self)){
+                    //take the flag back, unless a waker already has and its signal is on the way
+                    if (self.asleep.exchange(false))
+                        continue;
+                }
+
+                self.wake.wait();
+                continue;
+            }
+
+            seen = gen;
+
+            //jobs run under the same no allocation rule as processBlock
+            scopedAllocationCheck noAllocations;
+            work(self.index, gen);
+        }
+    }
+
+    //own queue first, then steal from the others in turn
+    void work(int self, uint32_t gen) noexcept{
+        //read after the generation, a claim only succeeds while the run they belong to is unfinished
+        auto numParticipants = participants.load(std::memory_order_relaxed);
+        auto* job = context.load(std::memory_order_relaxed);
+        auto* call = invoke.load(std::memory_order_relaxed);
+
+        for (auto offset = 0; offset < numParticipants; ++offset){
+            auto& q = queues[(size_t) ((self + offset) % numParticipants)];
+
+            for (auto index = claim(q, gen); index >= 0; index = claim(q, gen)){
+                call(job, index);
+                remaining.fetch_sub(1, std::memory_order_release);
+            }
+        }
+    }
+
+    //take the next job of a queue, -1 once it is empty or belongs to another run
+    static int claim(queue& q, uint32_t gen) noexcept{
+        auto cursor = q.cursor.load(std::memory_order_acquire);
+
+        for (;;){
+            auto next = (int) ((cursor >> 16) & 0xffff);
+            auto end = (int) (cursor & 0xffff);
+
+            if ((uint32_t) (cursor >> 32) != gen || next >= end)
+                return -1;
+
+            if (q.cursor.compare_exchange_weak(cursor, cursor + (1u << 16), std::memory_order_acq_rel))
+                return next;
+        }
+    }
+
+    std::array<std::unique_ptr<worker>, maxWorkers> workers;
+    std::array<queue, maxWorkers + 1> queues;
+    std::atomic<int> activeWorkers { 0 };
+    std::atomic<bool> stopping { false };
+    std::atomic<juce::int64> spinTicks { juce::Time::secondsToHighResolutionTicks(minSpinSeconds) };
+
+    //the run being worked on
+    std::atomic<uint32_t> generation { 0 };
+    std::atomic<int> participants { 1 };
+    std::atomic<void*> context { nullptr };
+    std::atomic<jobFunction> invoke { nullptr };
+    std::atomic<int> remaining { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (renderPool)
+};
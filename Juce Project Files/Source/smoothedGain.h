@@ -0,0 +1,160 @@
+//gain stages that ramp to new values instead of jumping
+
+#pragma once
+#include <JuceHeader.h>
+
+//drop in replacement for juce::dsp::Gain that ramps every change over a set time
+//juce::ValueSmoothingTypes::Linear ramps the gain itself, Multiplicative ramps evenly in decibels (gain must stay above 0)
+//the ramp is applied in place while the gain is applied, so smoothing costs no extra pass over the block
+template <typename smoothingType>
+class rampedGain
+{
+public:
+    rampedGain() {}
+
+    void setGainLinear(float newGain){
+        if (newGain == target)
+            return;
+
+        target = newGain;
+
+        //jump straight there before prepare or with no ramp time
+        if (rampLength <= 0){
+            current = target;
+            remaining = 0;
+            return;
+        }
+
+        remaining = rampLength;
+
+        if constexpr (isMultiplicative)
+            step = std::exp((std::log(target) - std::log(current)) / (float) rampLength);
+        else
+            step = (target - current) / (float) rampLength;
+    }
+
+    void setGainDecibels(float newGainDecibels){
+        setGainLinear(juce::Decibels::decibelsToGain(newGainDecibels));
+    }
+
+    float getGainLinear() const {
+        return target;
+    }
+
+    //ramp length for the following changes, a ramp in progress snaps to its target
+    void setRampDurationSeconds(double newDuration){
+        rampSeconds = newDuration;
+        rampLength = (int) std::floor(rampSeconds * sampleRate);
+        reset();
+    }
+
+    bool isSmoothing() const {
+        return remaining > 0;
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec){
+        sampleRate = spec.sampleRate;
+        setRampDurationSeconds(rampSeconds);
+    }
+
+    void reset(){
+        current = target;
+        remaining = 0;
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept{
+        auto&& inBlock = context.getInputBlock();
+        auto&& outBlock = context.getOutputBlock();
+
+        if (context.usesSeparateInputAndOutputBlocks())
+            outBlock.copyFrom(inBlock);
+
+        if (context.isBypassed)
+            return;
+
+        auto numSamples = (int) outBlock.getNumSamples();
+        auto numChannels = outBlock.getNumChannels();
+        auto numRamped = juce::jmin(numSamples, remaining);
+
+        //every channel gets the same ramp, starting from the same value
+        for (size_t chan = 0; chan < numChannels; ++chan){
+            auto* data = outBlock.getChannelPointer(chan);
+
+            if (numRamped > 0)
+                applyRamp(data, numRamped);
+
+            //whatever is left of the block sits on a constant gain
+            auto afterRamp = numRamped == remaining ? target : current;
+
+            if (afterRamp != 1.0f)
+                juce::FloatVectorOperations::multiply(data + numRamped, afterRamp, numSamples - numRamped);
+        }
+
+        advance(numRamped);
+    }
+
+private:
+    static constexpr bool isMultiplicative = std::is_same<smoothingType, juce::ValueSmoothingTypes::Multiplicative>::value;
+
+    //gain for sample i of the ramp is current * step^(i + 1) or current + step * (i + 1)
+    void applyRamp(float* data, int numSamples) const noexcept{
+        if constexpr (isMultiplicative){
+
+            //four independent running products so the loop vectorises
+            float lanes[4];
+            auto laneGain = current;
+
+            for (auto& lane : lanes){
+                laneGain *= step;
+                lane = laneGain;
+            }
+
+            auto step4 = (step * step) * (step * step);
+            auto i = 0;
+
+            for (; i + 4 <= numSamples; i += 4){
+                for (auto lane = 0; lane < 4; ++lane){
+                    data[i + lane] *= lanes[lane];
+                    lanes[lane] *= step4;
+                }
+            }
+
+            for (auto lane = 0; i < numSamples; ++i, ++lane)
+                data[i] *= lanes[lane];
+        }
+        else{
+            for (auto i = 0; i < numSamples; ++i)
+                data[i] *= current + step * (float) (i + 1);
+        }
+    }
+
+    void advance(int numSamples) noexcept{
+        if (numSamples <= 0)
+            return;
+
+        remaining -= numSamples;
+
+        if (remaining <= 0){
+            current = target;
+            remaining = 0;
+            return;
+        }
+
+        if constexpr (isMultiplicative)
+            current *= std::pow(step, (float) numSamples);
+        else
+            current += step * (float) numSamples;
+    }
+
+    float current = 1.0f;
+    float target = 1.0f;
+    float step = 0.0f;
+    int remaining = 0;
+
+    double sampleRate = 0;
+    double rampSeconds = 0.02;
+    int rampLength = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (rampedGain)
+};
@@ -0,0 +1,63 @@
+//time spent in each stage of voice rendering, for the benchmark
+
+#pragma once
+#include <JuceHeader.h>
+
+//stage timing is off unless the build turns it on, the benchmark does
+#ifndef SYNTH3D_STAGE_TIMING
+ #define SYNTH3D_STAGE_TIMING 0
+#endif
+
+//adds the time since the last start or lap to a stage, every call is empty unless SYNTH3D_STAGE_TIMING is set
+class stageClock
+{
+public:
+    enum stages{
+        envelopes,
+        oscillators,
+        convolution,
+        filters,
+        summing,
+        numStages
+    };
+
+    stageClock() {}
+
+    static const char* getStageName(int stage){
+        static const char* const names[numStages] = { "envelopes", "oscillators", "convolution", "filters", "summing" };
+        return names[stage];
+    }
+
+    static constexpr bool isEnabled(){
+        return SYNTH3D_STAGE_TIMING != 0;
+    }
+
+    void start() noexcept{
+       #if SYNTH3D_STAGE_TIMING
+        last = juce::Time::getHighResolutionTicks();
+       #endif
+    }
+
+    void lap(int stage) noexcept{
+       #if SYNTH3D_STAGE_TIMING
+        auto now = juce::Time::getHighResolutionTicks();
+        ticks[(size_t) stage] += now - last;
+        last = now;
+       #else
+        juce::ignoreUnused(stage);
+       #endif
+    }
+
+    //seconds counted for a stage since the last reset
+    double getSeconds(int stage) const {
+        return juce::Time::highResolutionTicksToSeconds(ticks[(size_t) stage]);
+    }
+
+    void reset(){
+        ticks.fill(0);
+    }
+
+private:
+    std::array<juce::int64, numStages> ticks {};
+    juce::int64 last = 0;
+};
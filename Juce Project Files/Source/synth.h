@@ -11,6 +11,13 @@
 
 #include <JuceHeader.h>
 #include "personalDS.h"
+#include "hrirConvolver.h"
+#include "oscillatorBank.h"
+#include "smoothedGain.h"
+#include "filterBank.h"
+#include "envelopeBank.h"
+#include "renderPool.h"
+#include "stageClock.h"
 
 
 struct synthSound   : public juce::SynthesiserSound
@@ -24,60 +31,26 @@ struct synthSound   : public juce::SynthesiserSound
 
 
 
-class synthVoice : public juce::SamplerVoice
+class synthVoice : public juce::SamplerVoice,
+                   public filterBank::client
 {
 public:
     
-    synthVoice(juce::AudioProcessorValueTreeState *p){
+    synthVoice(const hrirSpectra *hrirs){
         
-        //get preset synth parameters
-        synth_param = p;
-        
-        //set default waveshape
-        auto& osc_ob1 = osc1.template get<oscIndex>();
-        auto& osc_ob2 = osc2.template get<oscIndex>();
-        auto& osc_ob3 = osc3.template get<oscIndex>();
-        
-        osc_ob1.initialise(osc_sin, 128);
-        osc_ob2.initialise(osc_sin, 128);
-        osc_ob3.initialise(osc_sin, 128);
+        //point each binaural convolver at the shared HRIR spectra
+        osc1.template get<convIndex>().setResponses(hrirs);
+        osc2.template get<convIndex>().setResponses(hrirs);
+        osc3.template get<convIndex>().setResponses(hrirs);
         
         //set default values
         updateParameters();
         
-//        filter_gain.template setBypassed<filter1Index>(true);
-        
-    }
-    
-    float cent_offset(float note, float cent){
-        
-        //calulate the frequency offset from note from the cent value
-        auto offset = std::pow(2, cent /1200);
-        
-        return note*offset;
     }
     
-    //oscillator functions
-    static float osc_sin(float x){
-        return std::sin (x);
-    }
-
-    static float osc_saw(float x){
-        return juce::jmap<float>(x, (-juce::MathConstants<double>::pi), (juce::MathConstants<double>::pi), -1, 1);
-    }
-
-    static float osc_square(float x){
-        return std::sin (x) > 0 ? 1 : -1;
-    }
-
-    static float osc_triangle(float x){
-        return (2 / juce::MathConstants<double>::pi * std::asin(std::sin(x)));
-    }
-
-    static float osc_noise(float x){
-        //random generator
-        juce::Random random;
-        return (2*random.nextFloat()-1);
+    //pitch wheel position (0 to 16383, centred on 8192) to a pitch offset in octaves
+    float pitchWheelToOctaves(int position) const {
+        return (float) (position - 8192) / 8192.0f * (float) synth_param.pitch_bend_range / 12.0f;
     }
     
     void prepaterToPlay(int samplesPerBlock, int numChannels){
@@ -88,6 +61,8 @@ public:
         spec.numChannels = numChannels;
         
         //initilize dsp  devices
+        oscillators.prepare(getSampleRate());
+        
         osc1.reset();
         osc1.prepare(spec);
         osc2.reset();
@@ -95,112 +70,138 @@ public:
         osc3.reset();
         osc3.prepare(spec);
         
-        filter_gain.reset();
-        filter_gain.prepare(spec);
+        //the filters run in synthEngine's bank
+        filters.reset();
+        
+        totalGain_ob.prepare(spec);
+        totalGain_ob.reset();
+        
+        //ramp times depend on the sample rate
+        updateSmoothing();
         
         //set sample rate of ADSR
-        f_adsr.setSampleRate(getSampleRate());
-        a_adsr.setSampleRate(getSampleRate());
+        envelopes.setSampleRate(getSampleRate());
+        envelopes.reset();
+        
+        //allocate scratch buffers once so rendering never touches the heap
+        osc1_buf.setSize(numChannels, samplesPerBlock);
+        osc2_buf.setSize(numChannels, samplesPerBlock);
+        osc3_buf.setSize(numChannels, samplesPerBlock);
+        combined.setSize(numChannels, samplesPerBlock);
+        slot_buf.setSize(numSlots, samplesPerBlock);
+        env_buf.setSize(envelopeVoice::numEnvelopes, samplesPerBlock);
+    }
+    
+    //render dry per-oscillator slots for the processor's shared binaural bus instead of convolving here
+    void setBusRendering(bool shouldRenderToBus){
+        
+        if (busRendering == shouldRenderToBus)
+            return;
+        
+        busRendering = shouldRenderToBus;
+        
+        //skip the per-voice convolution while the bus does it
+        osc1.template setBypassed<convIndex>(busRendering);
+        osc2.template setBypassed<convIndex>(busRendering);
+        osc3.template setBypassed<convIndex>(busRendering);
+        
+        //drop any stale convolution tail from the other mode
+        osc1.template get<convIndex>().reset();
+        osc2.template get<convIndex>().reset();
+        osc3.template get<convIndex>().reset();
+        
+        filters.reset();
+    }
+    
+    //audio thread only: take new parameter values at a block boundary, recomputing only the changed parameterGroups
+    void setParameters(const synth_parameters& newParams, int changedGroups = allGroups){
+        synth_param = newParams;
+        updateParameters(changedGroups);
+        
+        //nothing is sounding to ramp, see snapSmoothing
+        if (! isVoiceActive())
+            snapSmoothing();
     }
     
-    void updateParameters(){
+    void updateParameters(int changedGroups = allGroups){
         
         //update parameters
-        updateGain();
-        updateFilter1Values();
-        updateFilter2Values();
-        updateEnvelopes();
-        updateFreqOff();
-        
-        //only update oscillator if waveshape changed
-        if(prevShape1 != *synth_param->getRawParameterValue("osc1wavShape") || prevShape2 != *synth_param->getRawParameterValue("osc2wavShape") ||   prevShape3 != *synth_param->getRawParameterValue("osc3wavShape") ){
-            
-            //set new previous shapes
-            prevShape1 = *synth_param->getRawParameterValue("osc1wavShape");
-            prevShape2 = *synth_param->getRawParameterValue("osc2wavShape");
-            prevShape3 = *synth_param->getRawParameterValue("osc3wavShape");
-            
-            //update oscillator shapes
+        if (changedGroups & gainGroup)
+            updateGain();
+        
+        if (changedGroups & filterGroup){
+            updateFilter1Values();
+            updateFilter2Values();
+        }
+        
+        if (changedGroups & envelopeGroup)
+            updateEnvelopes();
+        
+        if (changedGroups & smoothingGroup)
+            updateSmoothing();
+        
+        //a shape is just an index into the shared wavetable pool, set on the audio thread and read by the next bank pass, so no need to track changes here
+        if (changedGroups & oscillatorGroup){
+            updateFreqOff();
             updateOscillators();
+            
+            //the bend range may have changed under a bent wheel
+            oscillators.setPitch(pitchWheelToOctaves(pitchWheelPosition));
+        }
+        
+        if (! (changedGroups & hrirGroup))
+            return;
+        
+        //only swap impulse responses when an azimuth actually moved
+        float az1 = synth_param.osc1_az;
+        float az2 = synth_param.osc2_az;
+        float az3 = synth_param.osc3_az;
+        
+        if(prevAz1 != az1){
+            prevAz1 = az1;
+            loadHRTF(az1,1);
+        }
+        
+        if(prevAz2 != az2){
+            prevAz2 = az2;
+            loadHRTF(az2,2);
         }
         
-        loadHRTF(*synth_param->getRawParameterValue("osc1az"),1);
-        loadHRTF(*synth_param->getRawParameterValue("osc2az"),2);
-        loadHRTF(*synth_param->getRawParameterValue("osc3az"),3);
+        if(prevAz3 != az3){
+            prevAz3 = az3;
+            loadHRTF(az3,3);
+        }
         
     }
     
     void updateFreqOff(){
         
-        //set oscilator frequency
-        auto& osc_ob1 = osc1.template get<oscIndex>();
-        auto& osc_ob2 = osc2.template get<oscIndex>();
-        auto& osc_ob3 = osc3.template get<oscIndex>();
+        //detune ratios are only recomputed for the offsets that actually changed
+        const float offsets[] { synth_param.osc1_freqOff, synth_param.osc2_freqOff, synth_param.osc3_freqOff };
+        
+        for (auto osc = 0; osc < numSlots; ++osc){
+            if (offsets[osc] == detuneCents[osc])
+                continue;
+            
+            detuneCents[osc] = offsets[osc];
+            detuneRatio[osc] = std::exp2(offsets[osc] / 1200.0f);
+        }
         
-        osc_ob1.setFrequency(cent_offset(currentFrequency, *synth_param->getRawParameterValue("osc1freqOff")), false);
-        osc_ob2.setFrequency(cent_offset(currentFrequency, *synth_param->getRawParameterValue("osc2freqOff")), false);
-        osc_ob3.setFrequency(cent_offset(currentFrequency, *synth_param->getRawParameterValue("osc3freqOff")), false);
+        setOscillatorFrequencies();
+    }
+    
+    //set oscilator frequency from the note and the cached detune ratios
+    void setOscillatorFrequencies(){
+        for (auto osc = 0; osc < numSlots; ++osc)
+            oscillators.setFrequency(osc, (float) currentFrequency * detuneRatio[osc]);
     }
     
     void updateOscillators(){
         
-        auto& osc_ob1 = osc1.template get<oscIndex>();
-        auto& osc_ob2 = osc2.template get<oscIndex>();
-        auto& osc_ob3 = osc3.template get<oscIndex>();
-
-        switch((int)*synth_param->getRawParameterValue("osc1wavShape")){
-            case 1:
-                osc_ob1.initialise(osc_sin, 128);
-                break;
-            case 2:
-                osc_ob1.initialise(osc_saw, 128);
-                break;
-            case 3:
-                osc_ob1.initialise(osc_square, 128);
-                break;
-            case 4:
-                osc_ob1.initialise(osc_triangle, 128);
-                break;
-            case 5:
-                osc_ob1.initialise(osc_noise, 0);
-                break;
-        }
-    
-        switch((int)*synth_param->getRawParameterValue("osc2wavShape")){
-            case 1:
-                osc_ob2.initialise(osc_sin, 128);
-                break;
-            case 2:
-                osc_ob2.initialise(osc_saw, 128);
-                break;
-            case 3:
-                osc_ob2.initialise(osc_square, 128);
-                break;
-            case 4:
-                osc_ob2.initialise(osc_triangle, 128);
-                break;
-            case 5:
-                osc_ob2.initialise(osc_noise, 0);
-                break;
-        }
-    
-        switch((int)*synth_param->getRawParameterValue("osc3wavShape")){
-            case 1:
-                osc_ob3.initialise(osc_sin, 128);
-                break;
-            case 2:
-                osc_ob3.initialise(osc_saw, 128);
-                break;
-            case 3:
-                osc_ob3.initialise(osc_square, 128);
-                break;
-            case 4:
-                osc_ob3.initialise(osc_triangle, 128);
-                break;
-            case 5:
-                osc_ob3.initialise(osc_noise, 0);
-                break;
-        }
+        //band limited tables are shared, so this only picks which one to read
+        oscillators.setShape(0, synth_param.osc1_wavShape);
+        oscillators.setShape(1, synth_param.osc2_wavShape);
+        oscillators.setShape(2, synth_param.osc3_wavShape);
         
     }
     
@@ -217,21 +218,59 @@ public:
         auto& dis_ob3 = osc3.template get<disIndex>();
         
         //set knob gain
-        gain_ob1.setGainDecibels(*synth_param->getRawParameterValue("osc1gain"));
-        gain_ob2.setGainDecibels(*synth_param->getRawParameterValue("osc2gain"));
-        gain_ob3.setGainDecibels(*synth_param->getRawParameterValue("osc3gain"));
+        gain_ob1.setGainDecibels(synth_param.osc1_gain);
+        gain_ob2.setGainDecibels(synth_param.osc2_gain);
+        gain_ob3.setGainDecibels(synth_param.osc3_gain);
 
         //set distance gain
-        dis_ob1.setGainLinear((1-*synth_param->getRawParameterValue("osc1distance"))/2 + 0.5);
-        dis_ob2.setGainLinear((1-*synth_param->getRawParameterValue("osc2distance"))/2 + 0.5);
-        dis_ob3.setGainLinear((1-*synth_param->getRawParameterValue("osc3distance"))/2 + 0.5);
-        
-        //get totalgain from processor chain
-        auto& totalGain_ob = filter_gain.template get<totalGainIndex>();
+        dis_ob1.setGainLinear((1-synth_param.osc1_distance)/2 + 0.5);
+        dis_ob2.setGainLinear((1-synth_param.osc2_distance)/2 + 0.5);
+        dis_ob3.setGainLinear((1-synth_param.osc3_distance)/2 + 0.5);
         
         //set total gain
-        totalGain_ob.setGainDecibels(*synth_param->getRawParameterValue("totalGain"));
+        totalGain_ob.setGainDecibels(synth_param.total_gain);
+        
+    }
+    
+    //ramp length for every gain and the filter cuttoffs
+    void updateSmoothing(){
         
+        auto rampSeconds = synth_param.smoothing_time * 0.001;
+        
+        osc1.template get<gainIndex>().setRampDurationSeconds(rampSeconds);
+        osc2.template get<gainIndex>().setRampDurationSeconds(rampSeconds);
+        osc3.template get<gainIndex>().setRampDurationSeconds(rampSeconds);
+        
+        osc1.template get<disIndex>().setRampDurationSeconds(rampSeconds);
+        osc2.template get<disIndex>().setRampDurationSeconds(rampSeconds);
+        osc3.template get<disIndex>().setRampDurationSeconds(rampSeconds);
+        
+        totalGain_ob.setRampDurationSeconds(rampSeconds);
+        
+        filter1_cuttoff.reset(getSampleRate(), rampSeconds);
+        filter2_cuttoff.reset(getSampleRate(), rampSeconds);
+        filter1_resonance.reset(getSampleRate(), rampSeconds);
+        filter2_resonance.reset(getSampleRate(), rampSeconds);
+    }
+    
+    //ramps only move while the voice renders, so an idle voice lands every one on its target straight away
+    //otherwise a change made while it sat idle would be replayed as a fade at the start of its next note
+    //a sounding voice (including one about to be stolen) keeps ramping, so its gains never jump
+    void snapSmoothing(){
+        osc1.template get<gainIndex>().reset();
+        osc2.template get<gainIndex>().reset();
+        osc3.template get<gainIndex>().reset();
+        
+        osc1.template get<disIndex>().reset();
+        osc2.template get<disIndex>().reset();
+        osc3.template get<disIndex>().reset();
+        
+        totalGain_ob.reset();
+        
+        filter1_cuttoff.setCurrentAndTargetValue(filter1_cuttoff.getTargetValue());
+        filter2_cuttoff.setCurrentAndTargetValue(filter2_cuttoff.getTargetValue());
+        filter1_resonance.setCurrentAndTargetValue(filter1_resonance.getTargetValue());
+        filter2_resonance.setCurrentAndTargetValue(filter2_resonance.getTargetValue());
     }
     
     bool canPlaySound (juce::SynthesiserSound* sound) override
@@ -244,282 +283,559 @@ public:
         {
      
             currentFrequency = juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber);
+            setOscillatorFrequencies();
             
-            //set oscilator frequency
-            auto& osc_ob1 = osc1.template get<oscIndex>();
-            auto& osc_ob2 = osc2.template get<oscIndex>();
-            auto& osc_ob3 = osc3.template get<oscIndex>();
-            
-            osc_ob1.setFrequency(cent_offset(currentFrequency, *synth_param->getRawParameterValue("osc1freqOff")), false);
-            osc_ob2.setFrequency(cent_offset(currentFrequency, *synth_param->getRawParameterValue("osc2freqOff")), false);
-            osc_ob3.setFrequency(cent_offset(currentFrequency, *synth_param->getRawParameterValue("osc3freqOff")), false);
+            //start from wherever the wheel already is
+            pitchWheelPosition = currentPitchWheelPosition;
+            oscillators.setPitch(pitchWheelToOctaves(pitchWheelPosition), true);
             
             //start ADSRs
-            f_adsr.noteOn();
-            a_adsr.noteOn();
+            envelopes.noteOn();
             
         }
     
-    void loadHRTF(int p, int osc) // p is parameter for HRTF, osc is choosing which osc
+    void loadHRTF(float p, int osc) // p is parameter for HRTF, osc is choosing which osc
         {
-            int dataSize1;
-            const char * data1;
-            int dataSize2;
-            const char * data2;
-            int dataSize3;
-            const char * data3;
-            
             auto& conv_ob1 = osc1.template get<convIndex>();
             auto& conv_ob2 = osc2.template get<convIndex>();
             auto& conv_ob3 = osc3.template get<convIndex>();
             
-            // Comment:  We should ensure that p doesn't go above 359 by indexing
-            int azi;
+            //responses are already transformed, the convolver interpolates and crossfades to the new azimuth
+            if (osc == 1)
+                conv_ob1.setAzimuth(p);
             
-            if (osc == 1) {
-                int azi1 = p; // Giving the value to a separate variable (in case you want to change values on another osc right after?)
-                data1 = BinaryData::getNamedResource(BinaryData::namedResourceList[azi1], dataSize1);
-                conv_ob1.loadImpulseResponse(data1, dataSize1, juce::dsp::Convolution::Stereo::yes, juce::dsp::Convolution::Trim::yes, 0);
-                azi = azi1; // azi is returned to store the azimuth value for display
-            }
-            
-            if (osc == 2) {
-                int azi2 = p;
-                data2 = BinaryData::getNamedResource(BinaryData::namedResourceList[azi2], dataSize2);
-                conv_ob2.loadImpulseResponse(data2, dataSize2, juce::dsp::Convolution::Stereo::yes, juce::dsp::Convolution::Trim::yes, 0);
-                azi = azi2;
-            }
+            if (osc == 2)
+                conv_ob2.setAzimuth(p);
             
-            if (osc == 3) {
-                int azi3 = p;
-                data3 = BinaryData::getNamedResource(BinaryData::namedResourceList[azi3], dataSize3);
-                conv_ob3.loadImpulseResponse(data3, dataSize3, juce::dsp::Convolution::Stereo::yes, juce::dsp::Convolution::Trim::yes, 0);
-                azi = azi3;
-            }
+            if (osc == 3)
+                conv_ob3.setAzimuth(p);
             
     }
     
+    //the bank applies the bend per sample, gliding to it over a few milliseconds
+    void pitchWheelMoved (int newPitchWheelValue) override
+        {
+            pitchWheelPosition = newPitchWheelValue;
+            oscillators.setPitch(pitchWheelToOctaves(pitchWheelPosition));
+        }
+    
     void stopNote (float velocity, bool allowTailOff) override
         {
-            //turn off ADSRs
-            f_adsr.noteOff();
-            a_adsr.noteOff();
+            //hard stop (voice stolen or polyphony lowered), free the voice straight away
+            if (! allowTailOff){
+                clearVoice();
+                return;
+            }
+            
+            //turn off ADSRs, the voice frees itself once the release has finished
+            envelopes.noteOff();
 
         }
     
-    void updateFilter1Values(){
-        
-        //get filter from processor chain
-        auto& filter1_ob = filter_gain.template get<filter1Index>();
-        
+    //silence and free the voice so it stops being rendered
+    void clearVoice(){
+        envelopes.reset();
         
-        //select filter type and get coefficients
-        switch((int)*synth_param->getRawParameterValue("filter1type")){
-            case 1:
-                filter1_ob.setMode(juce::dsp::LadderFilterMode::LPF12);
-                filter1.setCoefficients(juce::IIRCoefficients::makeLowPass(getSampleRate(), *synth_param->getRawParameterValue("filter1cuttoff")));
-                break;
-            case 2:
-                filter1_ob.setMode(juce::dsp::LadderFilterMode::HPF12);
-                filter1.setCoefficients(juce::IIRCoefficients::makeHighPass(getSampleRate(), *synth_param->getRawParameterValue("filter1cuttoff")));
-                break;
-            case 3:
-                filter1_ob.setMode(juce::dsp::LadderFilterMode::BPF12);
-                filter1.setCoefficients(juce::IIRCoefficients::makeBandPass(getSampleRate(), *synth_param->getRawParameterValue("filter1cuttoff")));
-                break;
-            case 4:
-                filter1_ob.setMode(juce::dsp::LadderFilterMode::BPF12);
-                filter1.setCoefficients(juce::IIRCoefficients::makeNotchFilter(getSampleRate(), *synth_param->getRawParameterValue("filter1cuttoff")));
-                break;
-            default:
-                filter1_ob.setMode(juce::dsp::LadderFilterMode::LPF12);
-                filter1.setCoefficients(juce::IIRCoefficients::makeLowPass(getSampleRate(), *synth_param->getRawParameterValue("filter1cuttoff")));
-            
-        }
+        //start the next note without this one's convolution or filter state
+        osc1.template get<convIndex>().reset();
+        osc2.template get<convIndex>().reset();
+        osc3.template get<convIndex>().reset();
+        filters.reset();
         
-        //set cuttoff frequency and resonance
-//        filter1_ob.setCutoffFrequencyHz(*synth_param.filter1_cuttoff);
-        filter1_ob.setResonance(*synth_param->getRawParameterValue("filter1resonance"));
+        clearCurrentNote();
+    }
+    
+    //only the selected model of each slot runs, and its coefficients are only recomputed once type, cuttoff or resonance move
+    void updateFilter1Values(){
+        filters.setFilter(0, synth_param.filter1_model, synth_param.filter1_type);
         
-        filter1.reset();
+        //cuttoff and resonance glide to the new values at control rate
+        filter1_cuttoff.setTargetValue(synth_param.filter1_cuttoff);
+        filter1_resonance.setTargetValue(synth_param.filter1_resonance);
     }
 
     void updateFilter2Values(){
+        filters.setFilter(1, synth_param.filter2_model, synth_param.filter2_type);
         
-        //get filter from processor chain
-        auto& filter2_ob = filter_gain.template get<filter2Index>();
-        
-        //select filter type and get coefficients
-        switch((int)*synth_param->getRawParameterValue("filter2type")){
-            case 1:
-                filter2_ob.setMode(juce::dsp::LadderFilterMode::LPF12);
-                filter2.setCoefficients(juce::IIRCoefficients::makeLowPass(getSampleRate(), *synth_param->getRawParameterValue("filter2cuttoff")));
-                break;
-            case 2:
-                filter2_ob.setMode(juce::dsp::LadderFilterMode::HPF12);
-                filter2.setCoefficients(juce::IIRCoefficients::makeHighPass(getSampleRate(), *synth_param->getRawParameterValue("filter2cuttoff")));
-                break;
-            case 3:
-                filter2_ob.setMode(juce::dsp::LadderFilterMode::BPF12);
-                filter2.setCoefficients(juce::IIRCoefficients::makeBandPass(getSampleRate(), *synth_param->getRawParameterValue("filter2cuttoff")));
-                break;
-            case 4:
-                filter2_ob.setMode(juce::dsp::LadderFilterMode::LPF12);
-                filter2.setCoefficients(juce::IIRCoefficients::makeNotchFilter(getSampleRate(), *synth_param->getRawParameterValue("filter2cuttoff")));
-                break;
-            default:
-                filter2_ob.setMode(juce::dsp::LadderFilterMode::LPF12);
-                filter2.setCoefficients(juce::IIRCoefficients::makeLowPass(getSampleRate(), *synth_param->getRawParameterValue("filter2cuttoff")));
-        }
-        
-        //set cuttoff frequency and resonance
-//        filter2_ob.setCutoffFrequencyHz(*synth_param.filter2_cuttoff);
-        filter2_ob.setResonance(*synth_param->getRawParameterValue("filter2resonance"));
-            
-        filter2.reset();
+        //cuttoff and resonance glide to the new values at control rate
+        filter2_cuttoff.setTargetValue(synth_param.filter2_cuttoff);
+        filter2_resonance.setTargetValue(synth_param.filter2_resonance);
     }
 
     void updateEnvelopes(){
         
         //make parameter objects  with new parameter values
-        juce::ADSR::Parameters fParams(*synth_param->getRawParameterValue("filterAttack"),*synth_param->getRawParameterValue("filterDecay"), *synth_param->getRawParameterValue("filterSustain"),*synth_param->getRawParameterValue("filterRelease"));
+        juce::ADSR::Parameters fParams(synth_param.filter_attack,synth_param.filter_decay, synth_param.filter_sustain,synth_param.filter_release);
                                        
-        juce::ADSR::Parameters aParams(*synth_param->getRawParameterValue("ampAttack"),*synth_param->getRawParameterValue("ampDecay"), *synth_param->getRawParameterValue("ampSustain"),*synth_param->getRawParameterValue("ampRelease")*0.01);
+        juce::ADSR::Parameters aParams(synth_param.amp_attack,synth_param.amp_decay, synth_param.amp_sustain,synth_param.amp_release*0.01);
+        
+        envelopes.setParameters(envelopeVoice::filterEnvelope, fParams);
+        envelopes.setParameters(envelopeVoice::ampEnvelope, aParams);
+        envelopes.setExponential(synth_param.exponential_envelopes);
+    }
+    
+    //synthEngine renders every voice together through its banks, so a voice is never rendered on its own
+    void renderNextBlock (juce::AudioSampleBuffer&, int, int) override
+    {
+        jassertfalse;
+    }
+    
+    //longest chunk the scratch buffers hold
+    int getMaxChunk() const {
+        return combined.getNumSamples();
+    }
+    
+    //samples between filter envelope updates
+    int getFilterStep() const {
+        return synth_param.filter_step;
+    }
+    
+    //points the envelopes and oscillators at this chunk's buffers, ready to be rendered by an envelopeBank and an oscillatorBank
+    void startChunk(){
+        
+        //bus rendering keeps each oscillator dry in its own slot
+        for (auto osc = 0; osc < numSlots; ++osc)
+            oscillators.setOutput(osc, busRendering ? slot_buf.getWritePointer(osc) : osc_bufs[osc]->getWritePointer(0));
+        
+        for (auto env = 0; env < envelopeVoice::numEnvelopes; ++env)
+            envelopes.setOutput(env, env_buf.getWritePointer(env));
         
-        f_adsr.setParameters(fParams);
-        a_adsr.setParameters(aParams);
+        filterEnvelopePosition = 0;
     }
     
-    void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    envelopeVoice& getEnvelopes(){
+        return envelopes;
+    }
+    
+    oscillatorVoice& getOscillators(){
+        return oscillators;
+    }
+    
+    //once the oscillators are rendered: convolution and gains summed into the buffers the filters work on in place
+    void renderSources (int numOutputChannels, int numSamples)
             {
-                //make new buffer for each oscillator
-                juce::AudioBuffer<float> osc1_buf(outputBuffer.getNumChannels(), numSamples);
-                juce::AudioBuffer<float> osc2_buf(outputBuffer.getNumChannels(), numSamples);
-                juce::AudioBuffer<float> osc3_buf(outputBuffer.getNumChannels(), numSamples);
-                
-                //make a buffer for combined audio
-                juce::AudioBuffer<float> combined(outputBuffer.getNumChannels(), numSamples);
+                //the processor convolves each slot once for all voices
+                if (busRendering){
+                    renderSlots(numSamples);
+                    return;
+                }
                 
-                //process filter evelope to set to right value
-                f_adsr.applyEnvelopeToBuffer(combined, 0, numSamples);
+                //only use as many channels as both buffers have
+                auto numChannels = juce::jmin(numOutputChannels, combined.getNumChannels());
                 
-                //clear new buffers
-                osc1_buf.clear();
-                osc2_buf.clear();
-                osc3_buf.clear();
+                combined.clear(0, numSamples);
                 
-                combined.clear();
+                //every channel starts as the oscillator, the convolver turns channel 0 into both ears
+                for (auto* buf : osc_bufs)
+                    for (auto chan = 1; chan < buf->getNumChannels(); ++chan)
+                        buf->copyFrom(chan, 0, *buf, 0, 0, numSamples);
                 
-                //generate oscillator 1
-                juce::dsp::AudioBlock<float> block1(osc1_buf);
+                //oscillator 1
+                auto block1 = juce::dsp::AudioBlock<float>(osc1_buf).getSubBlock(0, (size_t) numSamples);
                 juce::dsp::ProcessContextReplacing<float> context1 (block1);
                 osc1.process(context1);
                 
-                //generate oscillator 2
-                juce::dsp::AudioBlock<float> block2(osc2_buf);
+                //oscillator 2
+                auto block2 = juce::dsp::AudioBlock<float>(osc2_buf).getSubBlock(0, (size_t) numSamples);
                 juce::dsp::ProcessContextReplacing<float> context2 (block2);
                 osc2.process(context2);
                 
-                //generate oscillator 3
-                juce::dsp::AudioBlock<float> block3(osc3_buf);
+                //oscillator 3
+                auto block3 = juce::dsp::AudioBlock<float>(osc3_buf).getSubBlock(0, (size_t) numSamples);
                 juce::dsp::ProcessContextReplacing<float> context3 (block3);
                 osc3.process(context3);
                 
                 //add sample for each channel
-                for (auto chan = outputBuffer.getNumChannels(); --chan >= 0;){
+                for (auto chan = numChannels; --chan >= 0;){
                     combined.addFrom(chan, 0, osc1_buf, chan, 0, numSamples);
                     combined.addFrom(chan, 0, osc2_buf, chan, 0, numSamples);
                     combined.addFrom(chan, 0, osc3_buf, chan, 0, numSamples);
                 }
                 
-                //get filter adsr next value
-                auto next_f_adsr = f_adsr.getNextSample();
+                filters.setChannels(combined.getArrayOfWritePointers(), numChannels);
+            }
+    
+    //bus rendering: each oscillator stays dry and mono in its own slot, filtered as the combined signal would have been
+    void renderSlots (int numSamples)
+            {
+                auto slots = juce::dsp::AudioBlock<float>(slot_buf).getSubBlock(0, (size_t) numSamples);
+                
+                //each oscillator was rendered straight into its slot
+                auto slot1 = slots.getSingleChannelBlock(0);
+                juce::dsp::ProcessContextReplacing<float> context1 (slot1);
+                osc1.process(context1);
                 
-                auto f1_new_cuttoff = next_f_adsr * (*synth_param->getRawParameterValue("filter1cuttoff"));
-                auto f2_new_cuttoff = next_f_adsr * (*synth_param->getRawParameterValue("filter2cuttoff"));
- 
-                //make sure cuttoff frequency is at least 20 hz
-                f1_new_cuttoff = std::fmax(f1_new_cuttoff,20);
-                f2_new_cuttoff = std::fmax(f2_new_cuttoff,20);
+                auto slot2 = slots.getSingleChannelBlock(1);
+                juce::dsp::ProcessContextReplacing<float> context2 (slot2);
+                osc2.process(context2);
                 
-                //get filter from processor chain
-                auto& filter1_ob = filter_gain.template get<filter1Index>();
-                auto& filter2_ob = filter_gain.template get<filter2Index>();
-
-                //set cuttoff frequency from adsr
-                filter1_ob.setCutoffFrequencyHz(f1_new_cuttoff);
-                filter2_ob.setCutoffFrequencyHz(f2_new_cuttoff);
+                auto slot3 = slots.getSingleChannelBlock(2);
+                juce::dsp::ProcessContextReplacing<float> context3 (slot3);
+                osc3.process(context3);
+                
+                filters.setChannels(slot_buf.getArrayOfWritePointers(), numSlots);
+            }
+    
+    //last stage of a chunk, once the filters have run: total gain and amp envelope, then mix into the output
+    void finishChunk (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples)
+            {
+                auto& source = busRendering ? slot_buf : combined;
+                
+                //slots go to the matching bus channel
+                auto numChannels = busRendering ? juce::jmin(numSlots, outputBuffer.getNumChannels())
+                                                : juce::jmin(outputBuffer.getNumChannels(), combined.getNumChannels());
+                
+                //apply total gain
+                auto block = juce::dsp::AudioBlock<float>(source).getSubBlock(0, (size_t) numSamples);
+                juce::dsp::ProcessContextReplacing<float> context (block);
+                totalGain_ob.process(context);
                 
-                //apply filter and gain
-                juce::dsp::AudioBlock<float> blockComb(combined);
-                juce::dsp::ProcessContextReplacing<float> contextComb (blockComb);
-                filter_gain.process(contextComb);
-
                 //apply adsr
-                a_adsr.applyEnvelopeToBuffer(combined, 0, numSamples);
-
-                //add sample for each channel
-                for (auto chan = outputBuffer.getNumChannels(); --chan >= 0;){
-
-                    //add to output buffer
-                    outputBuffer.addFrom(chan, startSample, combined, chan, 0, numSamples);
-                }
-
+                auto* ampEnvelope = env_buf.getReadPointer(envelopeVoice::ampEnvelope);
+                
+                for (auto chan = source.getNumChannels(); --chan >= 0;)
+                    juce::FloatVectorOperations::multiply(source.getWritePointer(chan), ampEnvelope, numSamples);
                 
+                //add to output buffer
+                for (auto chan = numChannels; --chan >= 0;)
+                    outputBuffer.addFrom(chan, startSample, source, chan, 0, numSamples);
+                
+                //the amp envelope is the last stage in both render modes (the bus convolves after the voices),
+                //so once its release is over nothing this voice owns can still be heard
+                if (envelopes.isFinished()){
+                    clearVoice();
+                    snapSmoothing();
+                }
             }
     
+    filterVoice& getFilters() override {
+        return filters;
+    }
+    
+    //move both filters to the filter envelope's cuttoff over the next numSamples samples
+    void updateFilterCuttoff(int numSamples) override {
+        
+        //the filter envelope was rendered with the chunk, read it at the end of the step
+        filterEnvelopePosition += numSamples;
+        auto next_f_adsr = env_buf.getSample(envelopeVoice::filterEnvelope, filterEnvelopePosition - 1);
+        
+        auto f1_new_cuttoff = next_f_adsr * filter1_cuttoff.skip(numSamples);
+        auto f2_new_cuttoff = next_f_adsr * filter2_cuttoff.skip(numSamples);
+
+        //make sure cuttoff frequency is at least 20 hz
+        f1_new_cuttoff = std::fmax(f1_new_cuttoff,20);
+        f2_new_cuttoff = std::fmax(f2_new_cuttoff,20);
+        
+        //set cuttoff frequency from adsr, the bank ramps across the step
+        filters.setTargets(0, f1_new_cuttoff, filter1_resonance.skip(numSamples));
+        filters.setTargets(1, f2_new_cuttoff, filter2_resonance.skip(numSamples));
+    }
+    
+    //number of oscillator slots, each one is a channel of the binaural bus
+    static constexpr int numSlots = 3;
+    
 
     
 private:
     //frequency variabls
     double currentFrequency = 0.0;
     
-    //loaded in synth parameters
-    juce::AudioProcessorValueTreeState *synth_param;
+    //each oscillator's offset in cents and the frequency ratio it gives
+    float detuneCents[numSlots] {};
+    float detuneRatio[numSlots] { 1.0f, 1.0f, 1.0f };
     
-    //IIR filter variables
-    juce::IIRFilter filter1;
-    juce::IIRFilter filter2;
+    int pitchWheelPosition = 8192;
     
-    //amplifier variables
-    double a_total_gain = 0;
-    double a_attack = 0;
-    double a_decay = 0;
-    double a_sustain = 1;
-    double a_release = 0;
+    //latest parameter snapshot handed over by the processor
+    synth_parameters synth_param;
     
     //ASDRs
-    juce::ADSR f_adsr;
-    juce::ADSR a_adsr;
+    envelopeVoice envelopes;
+    
+    //both envelopes for the chunk being rendered, and how far the filters have read into it
+    juce::AudioBuffer<float> env_buf;
+    int filterEnvelopePosition = 0;
     
-    //previous osc values
-    int prevShape1 = 1;
-    int prevShape2 = 1;
-    int prevShape3 = 1;
+    //preallocated scratch buffers for each oscillator and the combined signal
+    juce::AudioBuffer<float> osc1_buf;
+    juce::AudioBuffer<float> osc2_buf;
+    juce::AudioBuffer<float> osc3_buf;
+    juce::AudioBuffer<float> combined;
     
-    //Oscillator Process chains
-    juce::dsp::ProcessorChain<juce::dsp::Oscillator<float>, juce::dsp::Convolution, juce::dsp::Gain<float>, juce::dsp::Gain<float>> osc1;
-    juce::dsp::ProcessorChain<juce::dsp::Oscillator<float>, juce::dsp::Convolution, juce::dsp::Gain<float>, juce::dsp::Gain<float>> osc2;
-    juce::dsp::ProcessorChain<juce::dsp::Oscillator<float>, juce::dsp::Convolution, juce::dsp::Gain<float>, juce::dsp::Gain<float>> osc3;
+    //the oscillator buffers by index
+    std::array<juce::AudioBuffer<float>*, numSlots> osc_bufs { &osc1_buf, &osc2_buf, &osc3_buf };
+    
+    //dry oscillator slots for bus rendering
+    juce::AudioBuffer<float> slot_buf;
+    bool busRendering = false;
+    
+    //previous azimuths, -1 so the first update always loads a response
+    float prevAz1 = -1;
+    float prevAz2 = -1;
+    float prevAz3 = -1;
+    
+    //gains ramp evenly in decibels, distance ramps linearly
+    using decibelGain = rampedGain<juce::ValueSmoothingTypes::Multiplicative>;
+    using distanceGain = rampedGain<juce::ValueSmoothingTypes::Linear>;
+    
+    //all three oscillators, rendered by synthEngine's bank
+    oscillatorVoice oscillators;
+    
+    //Oscillator Process chains, run on what the bank rendered
+    juce::dsp::ProcessorChain<hrirConvolver, decibelGain, distanceGain> osc1;
+    juce::dsp::ProcessorChain<hrirConvolver, decibelGain, distanceGain> osc2;
+    juce::dsp::ProcessorChain<hrirConvolver, decibelGain, distanceGain> osc3;
     
     //enum to get each processor chain value
     enum{
-        oscIndex,
         convIndex,
         gainIndex,
         disIndex,
     };
     
-    //Filter and gain processing
-    juce::dsp::ProcessorChain<juce::dsp::LadderFilter<float>, juce::dsp::LadderFilter<float>, juce::dsp::Gain<float>> filter_gain;
+    //both filters and the total gain after them
+    filterVoice filters;
+    decibelGain totalGain_ob;
     
-    //enum to get each processor chain value
-    enum{
-        filter1Index,
-        filter2Index,
-        totalGainIndex
-    };
+    //filter cuttoffs before the envelope is applied, and resonances
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> filter1_cuttoff { 20000.0f };
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> filter2_cuttoff { 20000.0f };
+    juce::SmoothedValue<float> filter1_resonance;
+    juce::SmoothedValue<float> filter2_resonance;
+    
+};
+
+
+
+//synthesiser with a preallocated pool of voices, of which only the first "polyphony" may play
+class synthEngine : public juce::Synthesiser
+{
+public:
+    //size of the voice pool
+    static constexpr int maxVoices = 64;
+    
+    synthEngine() {}
+    
+    void setCurrentPlaybackSampleRate(double newRate) override {
+        juce::Synthesiser::setCurrentPlaybackSampleRate(newRate);
+        filtBank.prepare(newRate);
+    }
+    
+    //every voice in the pool is a synthVoice
+    synthVoice* getSynthVoice(int index) const {
+        return static_cast<synthVoice*> (getVoice(index));
+    }
+    
+    int getPolyphony() const {
+        return polyphony;
+    }
+    
+    //threads that share the voices' convolutions with the audio thread, start them before turning parallel rendering on
+    renderPool& getRenderPool() {
+        return pool;
+    }
+    
+    //spread the sounding voices' convolutions over the render pool instead of running them one after another
+    void setParallelRendering(bool shouldRenderInParallel){
+        parallelRendering = shouldRenderInParallel;
+    }
+    
+    bool isRenderingInParallel() const {
+        return parallelRendering;
+    }
+    
+    //time spent in each rendering stage, only counted in builds with SYNTH3D_STAGE_TIMING
+    stageClock& getStageClock() {
+        return clock;
+    }
+    
+    //render startSample to startSample + numSamples of the MIDI into the beginning of output, for callers whose buffers are
+    //smaller than the host's block, nothing is copied, so the events never need a buffer of their own
+    //renderNextBlock would still handle every event after the range once it is done, so only the range is walked here
+    void renderNextBlockToStart(juce::AudioBuffer<float>& output, const juce::MidiBuffer& midi, int startSample, int numSamples){
+        const juce::ScopedLock sl (lock);
+        
+        auto endSample = startSample + numSamples;
+        auto position = startSample;
+        outputOffset = startSample;
+        
+        for (auto it = midi.findNextSamplePosition(startSample); it != midi.cend(); ++it){
+            const auto metadata = *it;
+            
+            if (metadata.samplePosition >= endSample)
+                break;
+            
+            if (metadata.samplePosition > position){
+                renderVoices(output, position, metadata.samplePosition - position);
+                position = metadata.samplePosition;
+            }
+            
+            handleMidiEvent(metadata.getMessage());
+        }
+        
+        if (position < endSample)
+            renderVoices(output, position, endSample - position);
+        
+        outputOffset = 0;
+    }
+    
+    //change how many voices may sound at once, cutting off any above the limit
+    void setPolyphony(int newPolyphony){
+        const juce::ScopedLock sl (lock);
+        
+        polyphony = juce::jlimit(1, juce::jmax(1, voices.size()), newPolyphony);
+        
+        for (auto i = polyphony; i < voices.size(); ++i){
+            auto* voice = getSynthVoice(i);
+            
+            //the voice stays idle, so its ramps can land too
+            if (voice->isVoiceActive()){
+                voice->stopNote(0.0f, false);
+                voice->snapSmoothing();
+            }
+        }
+    }
+    
+protected:
+    //only hand out voices from the first "polyphony" in the pool
+    juce::SynthesiserVoice* findFreeVoice(juce::SynthesiserSound* soundToPlay, int midiChannel, int midiNoteNumber, bool stealIfNoneAvailable) const override {
+        const juce::ScopedLock sl (lock);
+        
+        auto numUsable = juce::jmin(polyphony, voices.size());
+        
+        for (auto i = 0; i < numUsable; ++i){
+            auto* voice = voices.getUnchecked(i);
+            
+            if (! voice->isVoiceActive() && voice->canPlaySound(soundToPlay))
+                return voice;
+        }
+        
+        if (stealIfNoneAvailable)
+            return findVoiceToSteal(soundToPlay, midiChannel, midiNoteNumber);
+        
+        return nullptr;
+    }
+    
+    //steal the oldest released voice, or failing that the oldest voice (no allocation, unlike the base class)
+    juce::SynthesiserVoice* findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int, int) const override {
+        juce::SynthesiserVoice* oldestReleased = nullptr;
+        juce::SynthesiserVoice* oldest = nullptr;
+        
+        auto numUsable = juce::jmin(polyphony, voices.size());
+        
+        for (auto i = 0; i < numUsable; ++i){
+            auto* voice = voices.getUnchecked(i);
+            
+            if (! voice->canPlaySound(soundToPlay))
+                continue;
+            
+            if (oldest == nullptr || voice->wasStartedBefore(*oldest))
+                oldest = voice;
+            
+            if (voice->isPlayingButReleased() && (oldestReleased == nullptr || voice->wasStartedBefore(*oldestReleased)))
+                oldestReleased = voice;
+        }
+        
+        return oldestReleased != nullptr ? oldestReleased : oldest;
+    }
+    
+    using juce::Synthesiser::renderVoices;
+    
+    //idle voices are skipped entirely, so cost follows the number of sounding notes
+    //each chunk runs in stages so the oscillators and filters of all sounding voices are rendered together by one bank each
+    //the convolutions in between are each voice's own work, so that stage can run on the render pool's threads
+    void renderVoices(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) override {
+        if (voices.isEmpty())
+            return;
+        
+        //every voice's scratch buffers are the same size
+        auto maxChunk = getSynthVoice(0)->getMaxChunk();
+        
+        if (maxChunk == 0)
+            return;
+        
+        auto numVoices = juce::jmin(voices.size(), maxVoices);
+        
+        while (numSamples > 0){
+            auto chunk = juce::jmin(numSamples, maxChunk);
+            auto numRendering = 0;
+            
+            for (auto i = 0; i < numVoices; ++i){
+                auto* voice = getSynthVoice(i);
+                
+                if (! voice->isVoiceActive())
+                    continue;
+                
+                rendering[(size_t) numRendering] = voice;
+                voice->startChunk();
+                
+                envelopeClients[(size_t) numRendering] = &voice->getEnvelopes();
+                oscillatorClients[(size_t) numRendering] = &voice->getOscillators();
+                filterClients[(size_t) numRendering++] = voice;
+            }
+            
+            if (numRendering == 0)
+                return;
+            
+            clock.start();
+            
+            envBank.process(envelopeClients.data(), numRendering, chunk);
+            clock.lap(stageClock::envelopes);
+            
+            oscBank.process(oscillatorClients.data(), numRendering, chunk);
+            clock.lap(stageClock::oscillators);
+            
+            auto numChannels = buffer.getNumChannels();
+            
+            auto renderSources = [this, numChannels, chunk] (int i){
+                rendering[(size_t) i]->renderSources(numChannels, chunk);
+            };
+            
+            //every voice renders into its own buffers, they are only mixed once the chunk is finished below
+            if (parallelRendering)
+                pool.run(numRendering, renderSources);
+            else
+                for (auto i = 0; i < numRendering; ++i)
+                    renderSources(i);
+            
+            clock.lap(stageClock::convolution);
+            
+            //every voice holds the same parameters, so any of them knows the envelope step
+            filtBank.process(filterClients.data(), numRendering, chunk, rendering[0]->getFilterStep());
+            clock.lap(stageClock::filters);
+            
+            for (auto i = 0; i < numRendering; ++i)
+                rendering[(size_t) i]->finishChunk(buffer, startSample - outputOffset, chunk);
+            
+            clock.lap(stageClock::summing);
+            
+            startSample += chunk;
+            numSamples -= chunk;
+        }
+    }
+    
+private:
+    int polyphony = maxVoices;
+    
+    //voices sounding in the chunk being rendered, filled without allocating
+    std::array<synthVoice*, maxVoices> rendering {};
+    std::array<envelopeVoice*, maxVoices> envelopeClients {};
+    std::array<oscillatorVoice*, maxVoices> oscillatorClients {};
+    std::array<filterBank::client*, maxVoices> filterClients {};
+    
+    envelopeBank envBank;
+    oscillatorBank oscBank;
+    filterBank filtBank;
+    
+    renderPool pool;
+    bool parallelRendering = false;
+    
+    //how far ahead of the output buffer the MIDI positions are, see renderNextBlockToStart
+    int outputOffset = 0;
+    
+    stageClock clock;
     
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (synthEngine)
 };
 
 #pragma once
@@ -0,0 +1,118 @@
+//band limited wavetables for the oscillators
+
+#pragma once
+#include <JuceHeader.h>
+
+//every waveshape stored as a mipmap of band limited tables (one per octave of playback frequency), all in one contiguous pool
+//built once, immutable afterwards and shared by all voices through juce::SharedResourcePointer, so any thread may read it
+//a single pool lets the oscillator bank address every oscillator's table as an offset from one base pointer
+class wavetableStore
+{
+public:
+    //matches the wave shape choices (1 based, the noise shapes have no table)
+    enum shapes{
+        sine = 1,
+        saw,
+        square,
+        triangle,
+        noise,
+        pinkNoise
+    };
+
+    //samples per table (one guard sample is added for interpolation)
+    static constexpr int tableSize = 2048;
+
+    //level 0 holds 1024 harmonics, every level above halves that, the last is a pure sine
+    static constexpr int numLevels = 11;
+
+    //amplitude of harmonic n (1 based) for a shape
+    using harmonicFunction = std::function<float(int)>;
+
+    wavetableStore(){
+        //slot 0 stays silent, it stands in for every shape without a table
+        pool.resize((size_t) (numTableShapes * numLevels * (tableSize + 1)));
+
+        build(sine, [](int n){ return n == 1 ? 1.0f : 0.0f; });
+
+        build(saw, [](int n){
+            return (n % 2 == 1 ? 2.0f : -2.0f) / (juce::MathConstants<float>::pi * (float) n);
+        });
+
+        build(square, [](int n){
+            return n % 2 == 1 ? 4.0f / (juce::MathConstants<float>::pi * (float) n) : 0.0f;
+        });
+
+        build(triangle, [](int n){
+            if (n % 2 == 0)
+                return 0.0f;
+
+            auto sign = ((n - 1) / 2) % 2 == 0 ? 1.0f : -1.0f;
+            return sign * 8.0f / (juce::MathConstants<float>::pi * juce::MathConstants<float>::pi * (float) (n * n));
+        });
+    }
+
+    //harmonics stored in a level
+    static int getMaxHarmonics(int level){
+        return 1024 >> level;
+    }
+
+    //lowest level whose harmonics all stay under nyquist for this phase increment (cycles per sample)
+    static int getLevelForIncrement(double increment){
+        auto harmonicsAllowed = 0.5 / juce::jmax(increment, 1.0e-9);
+        auto level = 0;
+
+        while (level < numLevels - 1 && getMaxHarmonics(level) > harmonicsAllowed)
+            ++level;
+
+        return level;
+    }
+
+    static bool hasTable(int shape){
+        return juce::isPositiveAndBelow(shape, numTableShapes);
+    }
+
+    //where a shape's table for a mip level starts in the pool, the noise shapes and anything out of range read silence
+    static int getTableOffset(int shape, int level){
+        return ((hasTable(shape) ? shape : 0) * numLevels + level) * (tableSize + 1);
+    }
+
+    const float* getPool() const noexcept {
+        return pool.data();
+    }
+
+    const float* getTable(int shape, int level) const noexcept {
+        return pool.data() + getTableOffset(shape, level);
+    }
+
+private:
+    //shapes below this have a table, slot 0 is the silent one
+    static constexpr int numTableShapes = noise;
+
+    void build(int shape, const harmonicFunction& amplitudeOfHarmonic){
+        juce::dsp::FFT fft(juce::roundToInt(std::log2((double) tableSize)));
+        std::vector<float> spectrum((size_t) tableSize * 2);
+
+        for (auto level = 0; level < numLevels; ++level){
+            std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+
+            //keep below the table's own nyquist
+            auto numHarmonics = juce::jmin(getMaxHarmonics(level), tableSize / 2 - 1);
+
+            //sin(n * (2 pi i / N - pi)) built by the inverse transform, phase matches juce::dsp::Oscillator
+            for (auto n = 1; n <= numHarmonics; ++n){
+                auto sign = (n % 2 == 0) ? 1.0f : -1.0f;
+                spectrum[(size_t) n * 2 + 1] = -amplitudeOfHarmonic(n) * sign * (float) tableSize * 0.5f;
+            }
+
+            fft.performRealOnlyInverseTransform(spectrum.data());
+
+            auto* table = pool.data() + getTableOffset(shape, level);
+            std::copy(spectrum.begin(), spectrum.begin() + tableSize, table);
+            table[tableSize] = table[0];
+        }
+    }
+
+    std::vector<float> pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (wavetableStore)
+};
@@ -0,0 +1,226 @@
+//time the synth over fixed note patterns and report the cost of each rendering stage as JSON
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "../../../Source/PluginProcessor.h"
+
+namespace
+{
+    const char* const usage =
+        "usage: synth3d-benchmark [options]\n"
+        "\n"
+        "  --patterns <list>   any of single,chord,retrigger,sweep (default all)\n"
+        "  --rates <list>      sample rates in Hz (default 44100,48000,96000)\n"
+        "  --blocks <list>     block sizes in samples (default 32,64,128,256,512,1024)\n"
+        "  --seconds <s>       audio timed per case, after half a second of warm up (default 2)\n"
+        "  --threads <n>       threads rendering voices, more than 1 turns on parallel voice rendering (default 1)\n"
+        "  --out <file>        write the JSON here instead of to stdout\n";
+
+    constexpr double warmUpSeconds = 0.5;
+
+    //a fixed note pattern, every run of it renders exactly the same audio
+    struct pattern
+    {
+        const char* name;
+
+        //adds the MIDI and any parameter automation for the block starting at position
+        std::function<void(PluginSynthAudioProcessor&, juce::MidiBuffer&, juce::int64 position, int blockSize, double sampleRate)> fillBlock;
+    };
+
+    const int chordNotes[] = { 48, 55, 60, 64, 67, 72, 76, 79 };
+
+    void startChord(juce::MidiBuffer& midi, juce::int64 position){
+        if (position == 0)
+            for (auto note : chordNotes)
+                midi.addEvent(juce::MidiMessage::noteOn(1, note, 0.8f), 0);
+    }
+
+    void setParameter(PluginSynthAudioProcessor& processor, int index, float value){
+        if (auto* parameter = processor.param.getParameter(synthParameters[index].id))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    std::vector<pattern> getPatterns(){
+        return {
+            //one held note
+            { "single", [](PluginSynthAudioProcessor&, juce::MidiBuffer& midi, juce::int64 position, int, double){
+                if (position == 0)
+                    midi.addEvent(juce::MidiMessage::noteOn(1, 60, 0.8f), 0);
+            }},
+
+            //eight held notes
+            { "chord", [](PluginSynthAudioProcessor&, juce::MidiBuffer& midi, juce::int64 position, int, double){
+                startChord(midi, position);
+            }},
+
+            //a new note every 25 ms, each one cutting off the last
+            { "retrigger", [](PluginSynthAudioProcessor&, juce::MidiBuffer& midi, juce::int64 position, int blockSize, double sampleRate){
+                auto period = (juce::int64) (0.025 * sampleRate);
+
+                for (auto start = (position + period - 1) / period * period; start < position + blockSize; start += period){
+                    auto step = (int) (start / period);
+                    auto offset = (int) (start - position);
+
+                    if (step > 0)
+                        midi.addEvent(juce::MidiMessage::noteOff(1, 48 + (step - 1) % 24), offset);
+
+                    midi.addEvent(juce::MidiMessage::noteOn(1, 48 + step % 24, 0.8f), offset);
+                }
+            }},
+
+            //eight held notes while the three oscillators circle the listener once a second
+            { "sweep", [](PluginSynthAudioProcessor& processor, juce::MidiBuffer& midi, juce::int64 position, int, double sampleRate){
+                startChord(midi, position);
+
+                auto turn = std::fmod((double) position / sampleRate, 1.0) * 359.0;
+
+                setParameter(processor, osc1azParam, (float) turn);
+                setParameter(processor, osc2azParam, (float) std::fmod(turn + 120.0, 359.0));
+                setParameter(processor, osc3azParam, (float) std::fmod(turn + 240.0, 359.0));
+            }},
+        };
+    }
+
+    //a comma separated option, or its default
+    juce::StringArray getList(const juce::ArgumentList& args, const juce::String& option, const juce::String& defaultList){
+        auto list = args.containsOption(option) ? args.getValueForOption(option) : defaultList;
+        return juce::StringArray::fromTokens(list, ",", {});
+    }
+
+    //time one pattern at one sample rate and block size
+    juce::var runCase(const pattern& notes, double sampleRate, int blockSize, double seconds, int numThreads){
+        PluginSynthAudioProcessor processor;
+
+        processor.setNumRenderWorkers(numThreads - 1);
+        setParameter(processor, parallelVoicesParam, numThreads > 1 ? 1.0f : 0.0f);
+
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer (processor.getTotalNumOutputChannels(), blockSize);
+        juce::MidiBuffer midi;
+        juce::int64 position = 0;
+
+        auto renderBlock = [&]{
+            midi.clear();
+            notes.fillBlock(processor, midi, position, blockSize, sampleRate);
+
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+            position += blockSize;
+        };
+
+        //fill the caches and let the notes start before anything is counted
+        while (position < (juce::int64) (warmUpSeconds * sampleRate))
+            renderBlock();
+
+        auto& clock = processor.getStageClock();
+        clock.reset();
+
+        auto measureStart = position;
+        auto startTicks = juce::Time::getHighResolutionTicks();
+
+        while (position - measureStart < (juce::int64) (seconds * sampleRate))
+            renderBlock();
+
+        auto totalSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        auto numSamples = (double) (position - measureStart);
+
+        processor.releaseResources();
+
+        //nanoseconds per sample of output, for the whole block and each stage
+        auto* costs = new juce::DynamicObject();
+        costs->setProperty("total", totalSeconds * 1.0e9 / numSamples);
+
+        if (stageClock::isEnabled()){
+            auto stagesSeconds = 0.0;
+
+            for (auto stage = 0; stage < stageClock::numStages; ++stage){
+                costs->setProperty(stageClock::getStageName(stage), clock.getSeconds(stage) * 1.0e9 / numSamples);
+                stagesSeconds += clock.getSeconds(stage);
+            }
+
+            //MIDI, parameter updates and anything else outside the stages
+            costs->setProperty("other", (totalSeconds - stagesSeconds) * 1.0e9 / numSamples);
+        }
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("pattern", notes.name);
+        result->setProperty("sampleRate", sampleRate);
+        result->setProperty("blockSize", blockSize);
+        result->setProperty("seconds", numSamples / sampleRate);
+        result->setProperty("nsPerSample", costs);
+        result->setProperty("realtimeFactor", numSamples / sampleRate / juce::jmax(totalSeconds, 1.0e-9));
+
+        return result;
+    }
+
+    int runBenchmark(const juce::ArgumentList& args){
+        if (args.containsOption("--help|-h")){
+            std::cout << usage;
+            return 0;
+        }
+
+        auto patternNames = getList(args, "--patterns", "single,chord,retrigger,sweep");
+        auto rates = getList(args, "--rates", "44100,48000,96000");
+        auto blocks = getList(args, "--blocks", "32,64,128,256,512,1024");
+        auto seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 2.0;
+        auto numThreads = args.containsOption("--threads") ? args.getValueForOption("--threads").getIntValue() : 1;
+
+        if (seconds <= 0.0 || numThreads < 1)
+            juce::ConsoleApplication::fail("--seconds or --threads is out of range");
+
+        juce::Array<juce::var> cases;
+
+        for (auto& name : patternNames){
+            auto patterns = getPatterns();
+            auto found = std::find_if(patterns.begin(), patterns.end(), [&name](const pattern& p){ return name == p.name; });
+
+            if (found == patterns.end())
+                juce::ConsoleApplication::fail("unknown pattern " + name);
+
+            for (auto& rate : rates){
+                for (auto& block : blocks){
+                    if (rate.getDoubleValue() < 8000.0 || block.getIntValue() < 1)
+                        juce::ConsoleApplication::fail("bad sample rate " + rate + " or block size " + block);
+
+                    //progress goes to stderr so stdout stays valid JSON
+                    std::cerr << found->name << " " << rate << " Hz " << block << " samples\n";
+                    cases.add(runCase(*found, rate.getDoubleValue(), block.getIntValue(), seconds, numThreads));
+                }
+            }
+        }
+
+        auto* report = new juce::DynamicObject();
+        report->setProperty("cpu", juce::SystemStats::getCpuModel());
+        report->setProperty("numCpus", juce::SystemStats::getNumCpus());
+        report->setProperty("threads", numThreads);
+        report->setProperty("stageTiming", stageClock::isEnabled());
+        report->setProperty("cases", cases);
+
+        auto json = juce::JSON::toString(juce::var(report));
+
+        if (args.containsOption("--out")){
+            auto outFile = args.getFileForOption("--out");
+
+            if (! outFile.replaceWithText(json))
+                juce::ConsoleApplication::fail("can't write " + outFile.getFullPathName());
+        }
+        else{
+            std::cout << json << "\n";
+        }
+
+        return 0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    //the processor's parameter state needs a message manager, but nothing here opens a window
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args (argc, argv);
+
+    return juce::ConsoleApplication::invokeCatchingFailures([&args]{ return runBenchmark(args); });
+}
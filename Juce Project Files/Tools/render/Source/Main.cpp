@@ -0,0 +1,193 @@
+//render a MIDI file through the synth to a WAV or FLAC file, no host or display needed
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "../../../Source/PluginProcessor.h"
+
+namespace
+{
+    const char* const usage =
+        "usage: synth3d-render --midi <file.mid> --out <file.wav|file.flac> [options]\n"
+        "\n"
+        "  --preset <file>     plugin state to load, the XML the plugin saves or its binary state\n"
+        "  --rate <hz>         sample rate (default 48000)\n"
+        "  --block <samples>   block size the synth is prepared for and driven with (default 512)\n"
+        "  --threads <n>       threads rendering voices, more than 1 turns on parallel voice rendering (default 1)\n"
+        "  --bits <16|24>      output bit depth (default 24)\n"
+        "  --tail <seconds>    most audio to keep rendering after the last MIDI event (default 10)\n";
+
+    //output below this (-100 dB) for a whole block counts as the end of the tail
+    constexpr float silenceThreshold = 1.0e-5f;
+
+    //every track of a Standard MIDI File merged into one sequence timed in seconds
+    juce::MidiMessageSequence readMidiFile(const juce::File& file)
+    {
+        juce::FileInputStream stream (file);
+
+        if (! stream.openedOk())
+            juce::ConsoleApplication::fail("can't open " + file.getFullPathName());
+
+        juce::MidiFile midiFile;
+
+        if (! midiFile.readFrom(stream))
+            juce::ConsoleApplication::fail(file.getFullPathName() + " is not a Standard MIDI File");
+
+        midiFile.convertTimestampTicksToSeconds();
+
+        juce::MidiMessageSequence sequence;
+
+        for (auto track = 0; track < midiFile.getNumTracks(); ++track)
+            sequence.addSequence(*midiFile.getTrack(track), 0.0);
+
+        sequence.sort();
+        return sequence;
+    }
+
+    //presets are the XML getStateInformation wraps, or the wrapped binary itself
+    void loadPreset(PluginSynthAudioProcessor& processor, const juce::File& file)
+    {
+        if (! file.existsAsFile())
+            juce::ConsoleApplication::fail("can't find preset " + file.getFullPathName());
+
+        juce::MemoryBlock state;
+
+        if (auto xml = juce::parseXML(file))
+            juce::AudioProcessor::copyXmlToBinary(*xml, state);
+        else
+            file.loadFileAsData(state);
+
+        processor.setStateInformation(state.getData(), (int) state.getSize());
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& file, double sampleRate, int numChannels, int bitsPerSample)
+    {
+        std::unique_ptr<juce::AudioFormat> format;
+
+        if (file.hasFileExtension("flac"))
+            format = std::make_unique<juce::FlacAudioFormat>();
+        else if (file.hasFileExtension("wav"))
+            format = std::make_unique<juce::WavAudioFormat>();
+        else
+            juce::ConsoleApplication::fail("the output must be a .wav or .flac file");
+
+        file.deleteFile();
+        auto stream = file.createOutputStream();
+
+        if (stream == nullptr || stream->failedToOpen())
+            juce::ConsoleApplication::fail("can't write to " + file.getFullPathName());
+
+        std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor(stream.get(), sampleRate, (unsigned int) numChannels, bitsPerSample, {}, 0));
+
+        if (writer == nullptr)
+            juce::ConsoleApplication::fail(format->getFormatName() + " can't be written at " + juce::String(sampleRate) + " Hz, " + juce::String(bitsPerSample) + " bits");
+
+        //the writer owns the stream now
+        stream.release();
+        return writer;
+    }
+
+    int render(const juce::ArgumentList& args)
+    {
+        if (args.containsOption("--help|-h") || args.size() == 0){
+            std::cout << usage;
+            return 0;
+        }
+
+        auto midiFile = args.getExistingFileForOption("--midi");
+        auto outFile = args.getFileForOption("--out");
+
+        auto sampleRate = args.containsOption("--rate") ? args.getValueForOption("--rate").getDoubleValue() : 48000.0;
+        auto blockSize = args.containsOption("--block") ? args.getValueForOption("--block").getIntValue() : 512;
+        auto numThreads = args.containsOption("--threads") ? args.getValueForOption("--threads").getIntValue() : 1;
+        auto bitsPerSample = args.containsOption("--bits") ? args.getValueForOption("--bits").getIntValue() : 24;
+        auto maxTail = args.containsOption("--tail") ? args.getValueForOption("--tail").getDoubleValue() : 10.0;
+
+        if (sampleRate < 8000.0 || blockSize < 1 || numThreads < 1 || maxTail < 0.0)
+            juce::ConsoleApplication::fail("--rate, --block, --threads or --tail is out of range");
+
+        auto sequence = readMidiFile(midiFile);
+
+        //the plugin exactly as a host would see it, just never given an editor
+        PluginSynthAudioProcessor processor;
+
+        if (args.containsOption("--preset"))
+            loadPreset(processor, args.getExistingFileForOption("--preset"));
+
+        //the calling thread renders too, so the pool only needs the rest
+        processor.setNumRenderWorkers(numThreads - 1);
+
+        if (auto* parallel = processor.param.getParameter(synthParameters[parallelVoicesParam].id))
+            parallel->setValueNotifyingHost(numThreads > 1 ? 1.0f : 0.0f);
+
+        processor.setNonRealtime(true);
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        auto numChannels = processor.getTotalNumOutputChannels();
+        auto writer = createWriter(outFile, sampleRate, numChannels, bitsPerSample);
+
+        juce::AudioBuffer<float> buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+
+        auto lastEventSample = (juce::int64) std::llround(sequence.getEndTime() * sampleRate);
+        auto maxTailSamples = (juce::int64) std::llround(maxTail * sampleRate);
+        auto numEvents = sequence.getNumEvents();
+        auto nextEvent = 0;
+        juce::int64 position = 0;
+
+        auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+        for (;;){
+            //this block's events, at their offsets into it
+            midi.clear();
+
+            for (; nextEvent < numEvents; ++nextEvent){
+                auto& message = sequence.getEventPointer(nextEvent)->message;
+                auto eventSample = (juce::int64) std::llround(message.getTimeStamp() * sampleRate);
+
+                if (eventSample >= position + blockSize)
+                    break;
+
+                if (! message.isMetaEvent())
+                    midi.addEvent(message, (int) juce::jmax((juce::int64) 0, eventSample - position));
+            }
+
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+
+            if (! writer->writeFromAudioSampleBuffer(buffer, 0, blockSize))
+                juce::ConsoleApplication::fail("writing " + outFile.getFullPathName() + " failed");
+
+            position += blockSize;
+
+            //once every event is in, stop at the first silent block or when the tail runs out
+            if (nextEvent < numEvents || position <= lastEventSample)
+                continue;
+
+            if (buffer.getMagnitude(0, blockSize) < silenceThreshold || position >= lastEventSample + maxTailSamples)
+                break;
+        }
+
+        processor.releaseResources();
+        writer.reset();
+
+        auto seconds = (double) position / sampleRate;
+        auto elapsed = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+        std::cout << outFile.getFullPathName() << ": " << juce::String(seconds, 2) << " s rendered in "
+                  << juce::String(elapsed, 2) << " s (" << juce::String(seconds / juce::jmax(elapsed, 1.0e-6), 1) << "x real time)\n";
+
+        return 0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    //the processor's parameter state needs a message manager, but nothing here opens a window
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args (argc, argv);
+
+    return juce::ConsoleApplication::invokeCatchingFailures([&args]{ return render(args); });
+}